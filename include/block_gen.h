@@ -4,19 +4,16 @@
 #include <iostream>
 #include <vector>
 #include <string>
-#include <openssl/sha.h>
 #include <curl/curl.h>
 #include <ctime>
 #include "kafka_server.h"
+#include "merkle.h"
 
 // Get transactions
 std::vector<std::string> getTransactions();
 
-// Calculate SHA256 hash
-std::string sha256(const std::string &data);
-
-// Calculate Merkle root
-std::string calculateMerkleRoot(const std::vector<std::string> &transactions);
+// Transaction id: SHA-256d of the serialized transaction, in internal byte order
+Hash256 transactionId(const std::string &rawTransaction);
 
 // Fetch the latest block hash
 std::string getBestBlockHash();
@@ -37,9 +34,20 @@ public:
     BlockGenerator(const std::string &previousHash, const double difficulty);
     // BlockHeader generateBlock();
 
+    // Template transactions by txid, coinbase first. The Merkle tree is kept between
+    // templates and updated incrementally, so a refresh costs in proportion to what changed.
+    // syncTransactions makes the transactions after the coinbase those of txids: ones that
+    // left are dropped, new ones appended in txids order, the rest keep their place.
+    void syncTransactions(const std::vector<Hash256> &txids);
+    void setCoinbase(const Hash256 &txid);
+
+    Hash256 merkleRoot();
+    std::vector<Hash256> merkleBranch();
+
 private:
     std::string previousHash;
     double difficulty;
+    IncrementalMerkleTree merkleTree;
 };
 
 #endif // BLOCK_GEN_H
@@ -14,6 +14,7 @@ private:
     std::string bestBlockHash;
     int blockHeight;
     double difficulty;
+    std::string bits; // compact target as the node reports it, in hex
     std::string merkleRoot;
     std::string target;
     uint32_t timestamp;
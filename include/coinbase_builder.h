@@ -0,0 +1,83 @@
+#ifndef COINBASE_BUILDER_H
+#define COINBASE_BUILDER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "sha256d.h"
+
+const size_t kExtranonce1Size = 4;
+const size_t kExtranonce2Size = 4;
+
+// Byte offset of every field of the coinbase transaction, in the legacy serialization
+// miners hash. All fields have a fixed size, so the extranonce slot, and with it the
+// coinbase1/coinbase2 split sent in mining.notify, is known at compile time.
+struct CoinbaseLayout
+{
+    static constexpr size_t kVersion = 0;
+    static constexpr size_t kInputCount = kVersion + 4;
+    static constexpr size_t kPrevOut = kInputCount + 1; // null txid, index 0xffffffff
+    static constexpr size_t kScriptSigLength = kPrevOut + 36;
+    // scriptSig: BIP34 height as a 3-byte push, the template time as a 4-byte push, the
+    // pool tag, then a push of the miner's extranonce1 + extranonce2
+    static constexpr size_t kHeightPush = kScriptSigLength + 1;
+    static constexpr size_t kTimePush = kHeightPush + 1 + 3;
+    static constexpr size_t kPoolTagPush = kTimePush + 1 + 4;
+    static constexpr size_t kPoolTagSize = 13; // "/mining-pool/"
+    static constexpr size_t kExtranoncePush = kPoolTagPush + 1 + kPoolTagSize;
+    static constexpr size_t kExtranonce = kExtranoncePush + 1;
+    static constexpr size_t kExtranonceSize = kExtranonce1Size + kExtranonce2Size;
+    static constexpr size_t kSequence = kExtranonce + kExtranonceSize;
+    static constexpr size_t kScriptSigSize = kSequence - kHeightPush;
+    static constexpr size_t kOutputCount = kSequence + 4;
+    // Output 0: payout to a P2PKH script, OP_DUP OP_HASH160 <20 bytes> OP_EQUALVERIFY OP_CHECKSIG
+    static constexpr size_t kPayoutValue = kOutputCount + 1;
+    static constexpr size_t kPayoutScriptLength = kPayoutValue + 8;
+    static constexpr size_t kPayoutScript = kPayoutScriptLength + 1;
+    static constexpr size_t kPayoutPubKeyHash = kPayoutScript + 3;
+    static constexpr size_t kPayoutScriptSize = 25;
+    // No BIP141 witness commitment output: templates carry no witness transactions, and a
+    // commitment that does not match the block's witness root makes the block invalid
+    static constexpr size_t kLockTime = kPayoutScript + kPayoutScriptSize;
+    static constexpr size_t kSize = kLockTime + 4;
+
+    // Heights whose minimal BIP34 encoding is exactly the 3-byte push above
+    static constexpr uint32_t kMinHeight = 1u << 15;
+    static constexpr uint32_t kMaxHeight = (1u << 23) - 1;
+
+    // mining.notify's coinbase1 ends where the extranonce starts; coinbase2 follows it
+    static constexpr size_t kCoinbase1Size = kExtranonce;
+    static constexpr size_t kCoinbase2Offset = kExtranonce + kExtranonceSize;
+};
+
+static_assert(CoinbaseLayout::kScriptSigSize >= 2 && CoinbaseLayout::kScriptSigSize <= 100,
+              "consensus limits on the coinbase scriptSig");
+// The pool tag pads the fixed prefix past one SHA-256 block, which is hashed once per job
+// into a midstate, so each share only hashes the block holding the extranonce
+static_assert(CoinbaseLayout::kCoinbase1Size >= 64, "coinbase1 must fill a whole SHA-256 block");
+static_assert(CoinbaseLayout::kSize == 117, "layout changed; Job rows written with the old layout no longer split");
+
+// Writes the coinbase straight into a fixed buffer laid out by CoinbaseLayout. The
+// constant fields are set once on construction; the setters patch their field in place.
+// The extranonce slot is left zero for the miner to fill.
+class CoinbaseBuilder
+{
+public:
+    CoinbaseBuilder();
+
+    // False, leaving the field unset, for heights outside kMinHeight..kMaxHeight: their
+    // BIP34 push is not 3 bytes long, so the block would be invalid
+    bool setHeight(uint32_t height);
+    void setTime(uint32_t time);
+    void setPayout(uint64_t satoshis, const std::array<uint8_t, 20> &pubKeyHash);
+
+    const uint8_t *data() const { return bytes_.data(); }
+    static constexpr size_t size() { return CoinbaseLayout::kSize; }
+    std::string toHex() const;
+
+private:
+    std::array<uint8_t, CoinbaseLayout::kSize> bytes_{};
+};
+
+#endif // COINBASE_BUILDER_H
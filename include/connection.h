@@ -0,0 +1,65 @@
+#ifndef CONNECTION_H
+#define CONNECTION_H
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "event_loop.h"
+#include "line_buffer.h"
+
+// Immutable payload that can sit in many connections' send queues at once.
+// A broadcast serializes once and every connection only holds a reference.
+class OutboundBuffer
+{
+public:
+    using DeliveryCallback = std::function<void(size_t delivered, std::chrono::nanoseconds lastByteAfter)>;
+
+    explicit OutboundBuffer(std::string data);
+    ~OutboundBuffer();
+
+    const std::string &data() const { return data_; }
+
+    // Report delivery once every connection has released the buffer: how many wrote it
+    // completely and how long after creation the last byte was handed to the kernel
+    void trackDelivery(DeliveryCallback callback) { onDelivered_ = std::move(callback); }
+
+    // Called by a connection after writing the final byte of this buffer
+    void markDelivered() const;
+
+private:
+    const std::string data_;
+    const std::chrono::steady_clock::time_point created_;
+    mutable std::atomic<size_t> delivered_{0};
+    mutable std::atomic<int64_t> lastDeliveredNs_{0};
+    DeliveryCallback onDelivered_;
+};
+
+using SharedBuffer = std::shared_ptr<const OutboundBuffer>;
+
+// State of one client socket served by a reactor.
+// inbound is only touched by the owning loop thread; the outbound queue may be
+// filled from any thread and is guarded by outMutex.
+struct Connection
+{
+    Connection(int fd, Poller *loop) : fd(fd), loop(loop), lastActive(std::chrono::steady_clock::now()) {}
+
+    const int fd;
+    Poller *const loop;
+    LineBuffer inbound;
+    std::chrono::steady_clock::time_point lastActive; // last time data arrived, for idle reaping
+
+    std::mutex outMutex;
+    std::deque<SharedBuffer> outbound;
+    size_t outboundOffset = 0;     // bytes of outbound.front() already written
+    size_t outboundBytes = 0;      // bytes queued and not yet written
+    bool writeArmed = false;       // EVENT_WRITE is registered with the loop
+    bool readPaused = false;       // reading suspended until the queue drains below the low watermark
+    bool closeWhenDrained = false; // close once the queued data has been written
+    bool closing = false;          // no more writes; the fd is about to be (or has been) closed
+};
+
+#endif // CONNECTION_H
@@ -0,0 +1,62 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <cstdint>
+#include <vector>
+
+// Readiness flags used for registration and reported by EventLoop::poll
+enum EventFlags : uint32_t
+{
+    EVENT_READ = 1u << 0,
+    EVENT_WRITE = 1u << 1,
+    EVENT_CLOSED = 1u << 2, // peer hung up or socket error (report only)
+};
+
+struct IoEvent
+{
+    int fd;
+    uint32_t flags;
+};
+
+// Interest registration as seen by a connection, whatever backend serves it.
+// modify/remove may be called from any thread.
+class Poller
+{
+public:
+    virtual ~Poller() = default;
+
+    virtual bool modify(int fd, uint32_t flags) = 0;
+    virtual void remove(int fd) = 0;
+
+    // True when the loop performs socket writes itself, so other threads must only queue
+    virtual bool submitsWrites() const { return false; }
+};
+
+// Level-triggered readiness notification over epoll (Linux) or kqueue (macOS/BSD).
+// add/modify/remove may be called from any thread; poll is called by the owning loop thread.
+class EventLoop : public Poller
+{
+public:
+    EventLoop();
+    ~EventLoop() override;
+
+    EventLoop(const EventLoop &) = delete;
+    EventLoop &operator=(const EventLoop &) = delete;
+
+    bool valid() const { return pollFd_ >= 0; }
+
+    bool add(int fd, uint32_t flags);
+    bool modify(int fd, uint32_t flags) override;
+    void remove(int fd) override;
+
+    // Wait up to timeoutMs for readiness; fills events and returns their count (-1 on error)
+    int poll(std::vector<IoEvent> &events, int timeoutMs);
+
+private:
+    int pollFd_;
+};
+
+// Put a descriptor into non-blocking mode
+bool setNonBlocking(int fd);
+
+#endif // EVENT_LOOP_H
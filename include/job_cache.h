@@ -0,0 +1,92 @@
+#ifndef JOB_CACHE_H
+#define JOB_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "coinbase_builder.h"
+#include "sha256d.h"
+#include "share_dedup.h"
+#include "uint256.h"
+
+// A mining job decoded once from its stored hex form. Immutable after publish, so share
+// validation and notify read it without locks through a shared_ptr. The only mutable part
+// is the set of accepted shares, which goes away with the last reference to the job.
+struct MiningJob
+{
+    std::string jobId;
+    std::vector<uint8_t> coinbase1; // coinbase bytes before the miner's extranonce
+    std::vector<uint8_t> coinbase2; // coinbase bytes after it
+    // coinbase1 split for hashing: whole 64-byte blocks folded into a midstate once per
+    // job, and the leftover bytes each share hashes ahead of its extranonce
+    Sha256Midstate coinbaseMidstate;
+    std::vector<uint8_t> coinbase1Tail;
+    std::vector<Hash256> merkleBranches;
+    Hash256 prevHash{}; // header byte order
+    uint32_t version = 0x20000000;
+    uint32_t nBits = 0; // compact form of target
+    Uint256 target;
+    // Assigned by JobCache::publish. generation counts published jobs and doubles as the
+    // Stratum job id; epochStart is the generation of the first job on this prevHash.
+    uint64_t generation = 0;
+    uint64_t epochStart = 0;
+    // The job's mining.notify line, serialized once by publish. Only ntime changes
+    // between sends; its 8 hex digits start at notifyTimeOffset.
+    std::string notifyMessage;
+    size_t notifyTimeOffset = 0;
+    mutable ShareDedupSet acceptedShares;
+};
+
+// A copy of the job's notify line with ntime set to time
+std::string notifyMessageAt(const MiningJob &job, uint32_t time);
+
+// Decode a Job row into its binary layout; nullptr if the coinbase does not have the
+// CoinbaseLayout size, as its split points would then be unknown. The Merkle column
+// holds the coinbase branch as concatenated 32-byte hashes; rows written as
+// comma-separated hex go through parseMerkleBranches first.
+std::shared_ptr<MiningJob> decodeMiningJob(const std::string &jobId,
+                                           const std::string &coinbaseHex,
+                                           std::vector<Hash256> merkleBranches,
+                                           const std::string &prevBlockHex,
+                                           const std::string &targetHex);
+std::vector<Hash256> parseMerkleBranches(std::string_view merkleHex);
+
+std::string toHex(const uint8_t *data, size_t size);
+// Decodes up to size bytes; returns how many were written (stops at the first bad digit)
+size_t fromHex(std::string_view hex, uint8_t *out, size_t size);
+
+// Stratum job ids are a job's generation in hex
+std::string formatJobId(uint64_t generation);
+bool parseJobId(std::string_view jobId, uint64_t &generation);
+
+// Bounded table of the most recent jobs, newest last. Publishing past capacity drops
+// the oldest job, after which shares for it are reported as unknown. A job on a new
+// prevHash starts a new epoch: every older job is stale from then on, which isStale
+// answers with one integer compare and no lock.
+class JobCache
+{
+public:
+    explicit JobCache(size_t capacity = 8);
+
+    // Assigns the job's generation and epoch, serializes its notify line, then makes it the latest
+    void publish(std::shared_ptr<MiningJob> job);
+    std::shared_ptr<const MiningJob> find(uint64_t generation) const;
+    std::shared_ptr<const MiningJob> latest() const;
+
+    bool isStale(uint64_t generation) const { return generation < epochStart_.load(std::memory_order_acquire); }
+
+private:
+    size_t capacity_;
+    mutable std::mutex mutex_;
+    std::deque<std::shared_ptr<const MiningJob>> jobs_;
+    uint64_t lastGeneration_ = 0;
+    std::atomic<uint64_t> epochStart_{0};
+};
+
+#endif // JOB_CACHE_H
@@ -0,0 +1,50 @@
+#ifndef LINE_BUFFER_H
+#define LINE_BUFFER_H
+
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+// Per-connection receive buffer for newline-framed protocols.
+// recv() writes straight into the free tail; complete lines are handed out as views
+// into the buffer, so no bytes are copied between the socket and the parser.
+// Read/write cursors wrap back to the start once everything has been consumed; a
+// partial line is moved to the front (or the buffer doubled, up to maxCapacity)
+// only when the tail runs out, so lines always stay contiguous.
+class LineBuffer
+{
+public:
+    explicit LineBuffer(size_t initialCapacity = 4096, size_t maxCapacity = 65536);
+
+    LineBuffer(LineBuffer &&) = default;
+    LineBuffer &operator=(LineBuffer &&) = default;
+
+    // Free space for the next recv(); makes room for at least minSpace bytes when possible
+    char *writePtr(size_t minSpace = 1024);
+    size_t writable() const { return capacity_ - writePos_; }
+    void commit(size_t bytes) { writePos_ += bytes; }
+
+    // Next complete line without its trailing "\n" / "\r\n".
+    // The view stays valid until the next writePtr() call.
+    bool nextLine(std::string_view &line);
+
+    // Unread bytes, for protocols that frame by length rather than by line
+    std::string_view peek() const { return std::string_view(data_.get() + readPos_, writePos_ - readPos_); }
+    void consume(size_t bytes);
+
+    size_t size() const { return writePos_ - readPos_; }
+    bool empty() const { return readPos_ == writePos_; }
+    // No room left and no complete line pending: the peer is sending an oversized message
+    bool full() const { return readPos_ == 0 && writePos_ == capacity_ && capacity_ >= maxCapacity_; }
+    void clear() { readPos_ = writePos_ = scanPos_ = 0; }
+
+private:
+    std::unique_ptr<char[]> data_;
+    size_t capacity_;
+    size_t maxCapacity_;
+    size_t readPos_ = 0;
+    size_t writePos_ = 0;
+    size_t scanPos_ = 0; // bytes before this offset are known to contain no '\n'
+};
+
+#endif // LINE_BUFFER_H
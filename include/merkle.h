@@ -0,0 +1,50 @@
+#ifndef MERKLE_H
+#define MERKLE_H
+
+#include <vector>
+#include "sha256d.h"
+
+// Bitcoin Merkle root of txids in internal byte order: each level hashes concatenated
+// pairs with SHA-256d, pairing the last node of an odd level with itself. Levels are
+// built in two buffers allocated up front; wide levels are split across threads.
+// An empty list gives an all-zero root.
+Hash256 calculateMerkleRoot(std::vector<Hash256> txids);
+
+// Siblings along the path of leaf 0, the coinbase, from the bottom up: the Merkle
+// branch Stratum sends. They do not depend on the coinbase, so its slot in txids is
+// ignored and the hashes that involve it are never computed.
+std::vector<Hash256> calculateCoinbaseBranch(std::vector<Hash256> txids);
+
+// Merkle tree that keeps every level, so a template change only rehashes the paths
+// above the leaves it touched. Appending or replacing a leaf costs one hash per level;
+// removing leaves shifts every later leaf and so dirties the tail from the first one
+// removed. Updates are applied lazily, batched per level, when root() or
+// coinbaseBranch() is read.
+class IncrementalMerkleTree
+{
+public:
+    // Replace all leaves; the next read builds the whole tree
+    void assign(std::vector<Hash256> leaves);
+    void append(const Hash256 &leaf);
+    void replace(size_t index, const Hash256 &leaf);
+    // indices in ascending order
+    void remove(const std::vector<size_t> &indices);
+
+    size_t size() const { return levels_.empty() ? 0 : levels_[0].size(); }
+    const Hash256 &leaf(size_t index) const { return levels_[0][index]; }
+
+    Hash256 root();
+    // Siblings along leaf 0's path, as calculateCoinbaseBranch returns them
+    std::vector<Hash256> coinbaseBranch();
+
+private:
+    void update();
+
+    std::vector<std::vector<Hash256>> levels_; // levels_[0] holds the leaves
+    std::vector<size_t> dirty_;                // leaves changed since the last update
+};
+
+// One level up: out[i] = SHA-256d(nodes[2i] || nodes[2i+1]) for i < pairs
+void hashMerkleLevel(const Hash256 *nodes, size_t pairs, Hash256 *out);
+
+#endif // MERKLE_H
@@ -0,0 +1,47 @@
+#ifndef SHA256D_H
+#define SHA256D_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+using Hash256 = std::array<uint8_t, 32>;
+
+// Hash implementations, picked from CPU features detected once per process
+enum class Sha256Backend
+{
+    Scalar,     // OpenSSL SHA256(), one message at a time
+    Lanes4,     // four messages per pass in 128-bit vectors (SSE2 / NEON)
+    Lanes8Avx2, // eight messages per pass in 256-bit AVX2 vectors
+    ShaNi,      // x86 SHA extensions, one message at a time
+};
+
+// Widest kernel used by sha256dHeaders, and the one used for single messages
+Sha256Backend sha256BatchBackend();
+Sha256Backend sha256SingleBackend();
+const char *sha256BackendName(Sha256Backend backend);
+
+// SHA-256 applied twice; out receives 32 bytes
+void sha256d(const uint8_t *data, size_t size, uint8_t *out);
+
+// SHA-256 state after the leading whole 64-byte blocks of a message. Messages that share
+// that prefix resume from it instead of hashing the prefix again.
+struct Sha256Midstate
+{
+    uint32_t state[8];
+    uint64_t absorbed = 0; // bytes hashed into state, a multiple of 64
+};
+
+Sha256Midstate sha256Midstate(const uint8_t *data, size_t blocks);
+// SHA-256d of the absorbed prefix followed by size bytes of data
+void sha256dResume(const Sha256Midstate &midstate, const uint8_t *data, size_t size, uint8_t *out);
+
+// SHA-256d of count consecutive 80-byte block headers into count consecutive 32-byte
+// digests. Multi-buffer backends hash several headers per pass, so callers with many
+// shares pending should hand them over in one call.
+void sha256dHeaders(const uint8_t *headers, size_t count, uint8_t *out);
+
+// The same for count consecutive 64-byte messages, such as pairs of Merkle nodes
+void sha256d64(const uint8_t *messages, size_t count, uint8_t *out);
+
+#endif // SHA256D_H
@@ -0,0 +1,48 @@
+#ifndef SHARE_DEDUP_H
+#define SHARE_DEDUP_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Set of 64-bit share fingerprints for one job. Fingerprints are split across shards by
+// their top bits; each shard is an open-addressing table with linear probing that doubles
+// at half load, so memory follows the number of accepted shares up to maxEntries.
+class ShareDedupSet
+{
+public:
+    enum class Insert
+    {
+        New,
+        Duplicate,
+        Full, // maxEntries reached; the fingerprint was not recorded
+    };
+
+    explicit ShareDedupSet(size_t maxEntries = size_t(1) << 22);
+
+    ShareDedupSet(const ShareDedupSet &) = delete;
+    ShareDedupSet &operator=(const ShareDedupSet &) = delete;
+
+    Insert insert(uint64_t fingerprint);
+    size_t size() const;
+
+private:
+    static const size_t kShards = 64;
+    static const size_t kInitialSlots = 64;
+
+    struct Shard
+    {
+        mutable std::mutex mutex;
+        std::vector<uint64_t> slots; // 0 marks an empty slot
+        size_t count = 0;
+    };
+
+    static bool place(std::vector<uint64_t> &slots, uint64_t fingerprint);
+
+    std::array<Shard, kShards> shards_;
+    size_t maxPerShard_;
+};
+
+#endif // SHARE_DEDUP_H
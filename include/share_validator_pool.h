@@ -0,0 +1,51 @@
+#ifndef SHARE_VALIDATOR_POOL_H
+#define SHARE_VALIDATOR_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "mpmc_queue.h"
+#include "task_validator.h"
+
+// Fixed set of threads validating queued shares in batches. Network threads only ever
+// push onto the lock-free queue; hashing and the completion callback run on the pool's
+// threads, which pass finished shares on to the writer.
+class ShareValidatorPool
+{
+public:
+    // Called on a pool thread once share.result is set
+    using Completion = std::function<void(const ShareSubmission &share)>;
+
+    ShareValidatorPool(size_t threads, size_t queueCapacity, ShareWriter &writer, Completion onValidated);
+    ~ShareValidatorPool();
+
+    ShareValidatorPool(const ShareValidatorPool &) = delete;
+    ShareValidatorPool &operator=(const ShareValidatorPool &) = delete;
+
+    // Never blocks; false when the queue is full and the share was not taken
+    bool submit(ShareSubmission &&share);
+
+    // Validate whatever is still queued, then join the threads
+    void stop();
+
+    size_t queued() const { return queue_.sizeApprox(); }
+
+private:
+    void run();
+
+    MpmcQueue<ShareSubmission> queue_;
+    ShareWriter &writer_;
+    Completion onValidated_;
+    std::vector<std::thread> threads_;
+    std::atomic<bool> running_{true};
+
+    // Idle workers sleep here; producers only touch the mutex when someone is sleeping
+    std::mutex idleMutex_;
+    std::condition_variable idleCv_;
+    std::atomic<size_t> idleWorkers_{0};
+};
+
+#endif // SHARE_VALIDATOR_POOL_H
@@ -0,0 +1,68 @@
+#ifndef SHARE_WRITER_H
+#define SHARE_WRITER_H
+
+#include <sqlite3.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "mpmc_queue.h"
+#include "uint256.h"
+
+// One row of the Share table
+struct ShareRecord
+{
+    std::string workerName;
+    std::string jobId;
+    bool valid = false;
+    Uint256 target;
+};
+
+// Persists shares on a dedicated thread. Records are queued without touching the
+// database and written in group-committed transactions through one prepared insert,
+// so the sync cost of a commit is paid once per batch instead of once per share.
+class ShareWriter
+{
+public:
+    explicit ShareWriter(size_t queueCapacity);
+    ~ShareWriter();
+
+    ShareWriter(const ShareWriter &) = delete;
+    ShareWriter &operator=(const ShareWriter &) = delete;
+
+    // Safe from any thread. Only waits if the writer has fallen a whole queue behind,
+    // which pushes back on validation rather than losing shares.
+    void record(ShareRecord &&share);
+
+    // Write whatever is still queued, then join the thread
+    void stop();
+
+    size_t queued() const { return queue_.sizeApprox(); }
+    uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+    // Shares the database refused, or whose batch still failed after every retry
+    uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+    // One transaction over batch[0, count). False if it was rolled back, e.g. because
+    // another connection held the lock; nothing was written and the batch can be retried.
+    bool writeBatch(const std::vector<ShareRecord> &batch, size_t count);
+
+    sqlite3 *db_ = nullptr;
+    sqlite3_stmt *insertShare_ = nullptr;
+
+    MpmcQueue<ShareRecord> queue_;
+    std::thread thread_;
+    std::atomic<bool> running_{true};
+    std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> dropped_{0};
+
+    // The writer sleeps between flushes; producers wake it early once a full batch is waiting
+    std::mutex idleMutex_;
+    std::condition_variable idleCv_;
+    std::atomic<bool> idle_{false};
+};
+
+#endif // SHARE_WRITER_H
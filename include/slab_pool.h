@@ -0,0 +1,180 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Ids handed out by SlabPool: slot index in the low 32 bits, slot generation in the
+// high 32 bits. A released slot bumps its generation, so stale ids never resolve to
+// the slot's next occupant. 0 is never a valid id.
+inline uint32_t slabIndex(uint64_t id) { return static_cast<uint32_t>(id); }
+inline uint32_t slabGeneration(uint64_t id) { return static_cast<uint32_t>(id >> 32); }
+
+// Per-slot storage allocated in fixed chunks on first use and kept until destruction,
+// so addresses are stable and memory is bounded by capacity * sizeof(T).
+template <typename T>
+class SlotTable
+{
+public:
+    static const size_t kChunkSize = 1024;
+
+    explicit SlotTable(size_t capacity)
+        : capacity_(capacity), chunks_(new std::atomic<T *>[(capacity + kChunkSize - 1) / kChunkSize])
+    {
+        for (size_t i = 0; i < chunkCount(); ++i)
+        {
+            chunks_[i].store(nullptr, std::memory_order_relaxed);
+        }
+    }
+
+    ~SlotTable()
+    {
+        for (size_t i = 0; i < chunkCount(); ++i)
+        {
+            delete[] chunks_[i].load();
+        }
+    }
+
+    SlotTable(const SlotTable &) = delete;
+    SlotTable &operator=(const SlotTable &) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Slot by index; the chunk is allocated on first access
+    T &at(uint32_t index)
+    {
+        std::atomic<T *> &chunk = chunks_[index / kChunkSize];
+        T *slots = chunk.load(std::memory_order_acquire);
+        if (!slots)
+        {
+            std::lock_guard<std::mutex> lock(growMutex_);
+            slots = chunk.load(std::memory_order_relaxed);
+            if (!slots)
+            {
+                slots = new T[kChunkSize];
+                chunk.store(slots, std::memory_order_release);
+            }
+        }
+        return slots[index % kChunkSize];
+    }
+
+    // Slot by index if its chunk exists, without allocating
+    T *peek(uint32_t index) const
+    {
+        if (index >= capacity_)
+        {
+            return nullptr;
+        }
+        T *slots = chunks_[index / kChunkSize].load(std::memory_order_acquire);
+        return slots ? &slots[index % kChunkSize] : nullptr;
+    }
+
+    T &operator[](uint64_t id) { return at(slabIndex(id)); }
+
+private:
+    size_t chunkCount() const { return (capacity_ + kChunkSize - 1) / kChunkSize; }
+
+    const size_t capacity_;
+    std::unique_ptr<std::atomic<T *>[]> chunks_;
+    std::mutex growMutex_;
+};
+
+// Bounded object pool with O(1) acquire, release and lookup by generation-tagged id.
+template <typename T>
+class SlabPool
+{
+public:
+    explicit SlabPool(size_t capacity) : slots_(capacity) {}
+
+    // Take a free slot, or nullptr when the pool is full. The object keeps whatever
+    // state its previous occupant left, so callers reset what they use.
+    T *acquire(uint64_t &id)
+    {
+        uint32_t index;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!freeList_.empty())
+            {
+                index = freeList_.back();
+                freeList_.pop_back();
+            }
+            else if (highWater_ < slots_.capacity())
+            {
+                index = static_cast<uint32_t>(highWater_++);
+            }
+            else
+            {
+                return nullptr;
+            }
+            ++live_;
+        }
+
+        Slot &slot = slots_.at(index);
+        uint32_t generation = slot.generation.load(std::memory_order_relaxed);
+        if (generation == 0)
+        {
+            generation = 1;
+            slot.generation.store(generation, std::memory_order_release);
+        }
+        id = (static_cast<uint64_t>(generation) << 32) | index;
+        return &slot.value;
+    }
+
+    void release(uint64_t id)
+    {
+        Slot *slot = slots_.peek(slabIndex(id));
+        uint32_t generation = slabGeneration(id);
+        if (!slot || !slot->generation.compare_exchange_strong(generation, nextGeneration(generation)))
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        freeList_.push_back(slabIndex(id));
+        --live_;
+    }
+
+    // Object for a live id, or nullptr if the id was released. The memory stays valid
+    // after a concurrent release, so callers re-check ownership under their own lock.
+    T *find(uint64_t id)
+    {
+        Slot *slot = slots_.peek(slabIndex(id));
+        if (!slot || slot->generation.load(std::memory_order_acquire) != slabGeneration(id))
+        {
+            return nullptr;
+        }
+        return &slot->value;
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return live_;
+    }
+
+    size_t capacity() const { return slots_.capacity(); }
+
+private:
+    struct Slot
+    {
+        std::atomic<uint32_t> generation{0};
+        T value;
+    };
+
+    static uint32_t nextGeneration(uint32_t generation)
+    {
+        return generation == UINT32_MAX ? 1 : generation + 1;
+    }
+
+    SlotTable<Slot> slots_;
+    mutable std::mutex mutex_;
+    std::vector<uint32_t> freeList_;
+    size_t highWater_ = 0;
+    size_t live_ = 0;
+};
+
+#endif // SLAB_POOL_H
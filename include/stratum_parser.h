@@ -0,0 +1,112 @@
+#ifndef STRATUM_PARSER_H
+#define STRATUM_PARSER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+const size_t kMaxStratumParams = 8;
+
+// One Stratum JSON-RPC request. Every field is a view into the received line (or into
+// the fallback parser's storage), so it is only valid while that line is.
+struct StratumRequest
+{
+    std::string_view id;     // raw JSON token, quotes included for string ids; empty if absent
+    std::string_view method;
+    std::array<std::string_view, kMaxStratumParams> params; // string contents or raw scalar tokens
+    size_t paramCount = 0;
+
+    std::string_view idOrNull() const { return id.empty() ? std::string_view("null") : id; }
+    std::string_view param(size_t index) const { return index < paramCount ? params[index] : std::string_view(); }
+};
+
+// Allocation-free parser for the flat shapes Stratum uses: an object with scalar members
+// and a "params" array of scalars. Returns false on anything else (escaped strings, nested
+// values, malformed input), in which case the caller falls back to parseStratumRequestSlow.
+bool parseStratumRequest(std::string_view line, StratumRequest &request);
+
+// jsoncpp-based parser for unusual but valid input; decoded strings are kept in storage
+bool parseStratumRequestSlow(std::string_view line, StratumRequest &request, std::vector<std::string> &storage);
+
+// Methods the server dispatches on; values index StratumServer's handler table
+enum class StratumMethod : uint8_t
+{
+    Unknown,
+    Submit,
+    Subscribe,
+    Authorize,
+    ExtranonceSubscribe,
+    Notify,
+    Configure,
+    SuggestDifficulty,
+    Count
+};
+
+namespace stratum_detail
+{
+constexpr std::string_view kMethodNames[] = {
+    "",
+    "mining.submit",
+    "mining.subscribe",
+    "mining.authorize",
+    "mining.extranonce.subscribe",
+    "mining.notify",
+    "mining.configure",
+    "mining.suggest_difficulty",
+};
+static_assert(std::size(kMethodNames) == static_cast<size_t>(StratumMethod::Count), "kMethodNames must follow StratumMethod");
+
+// Every name shares the "mining." prefix, so hash the first byte after it and the
+// second-to-last byte. Callers guarantee name.size() > 7.
+constexpr size_t kMethodSlots = 32;
+constexpr size_t methodSlot(std::string_view name)
+{
+    return (static_cast<unsigned char>(name[7]) + 2u * static_cast<unsigned char>(name[name.size() - 2])) % kMethodSlots;
+}
+
+constexpr std::array<StratumMethod, kMethodSlots> buildMethodSlots()
+{
+    std::array<StratumMethod, kMethodSlots> slots{};
+    for (size_t i = 1; i < std::size(kMethodNames); ++i)
+    {
+        slots[methodSlot(kMethodNames[i])] = static_cast<StratumMethod>(i);
+    }
+    return slots;
+}
+
+constexpr std::array<StratumMethod, kMethodSlots> kMethodSlotTable = buildMethodSlots();
+
+constexpr bool methodSlotsArePerfect()
+{
+    for (size_t i = 1; i < std::size(kMethodNames); ++i)
+    {
+        if (kMethodSlotTable[methodSlot(kMethodNames[i])] != static_cast<StratumMethod>(i))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(methodSlotsArePerfect(), "Stratum method names collide in methodSlot; adjust the hash");
+}
+
+// One hash probe and one comparison; mining.submit, the bulk of all traffic, is matched first
+constexpr StratumMethod lookupStratumMethod(std::string_view name)
+{
+    using namespace stratum_detail;
+    if (name == kMethodNames[static_cast<size_t>(StratumMethod::Submit)])
+    {
+        return StratumMethod::Submit;
+    }
+    if (name.size() <= 7)
+    {
+        return StratumMethod::Unknown;
+    }
+    StratumMethod method = kMethodSlotTable[methodSlot(name)];
+    return kMethodNames[static_cast<size_t>(method)] == name ? method : StratumMethod::Unknown;
+}
+
+#endif // STRATUM_PARSER_H
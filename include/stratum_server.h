@@ -3,9 +3,15 @@
 #define STRATUM_SERVER_H
 
 #include "tcp_server.h"
+#include "slab_pool.h"
+#include "job_cache.h"
+#include "share_validator_pool.h"
+#include "stratum_parser.h"
+#include "vardiff.h"
 #include <string>
-#include <json/json.h>
-#include <unordered_set>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
 
 class Miner
 {
@@ -23,6 +29,21 @@ private:
     std::string address_;
 };
 
+// Per-connection Stratum state. Lives in StratumServer's session slab and is only
+// touched by the thread serving its connection, except vardiff, which validator threads
+// also update; it is guarded by StratumServer's clientMutex_.
+struct MinerSession
+{
+    int fd = -1;
+    std::string username; // set once mining.authorize succeeds
+    std::string extranonce1;
+    VardiffController vardiff;
+    bool authorized = false;
+    // Submits and how many of them were for a superseded block, for the stale rate
+    uint64_t sharesSubmitted = 0;
+    uint64_t sharesStale = 0;
+};
+
 class MinerManager
 {
 public:
@@ -34,6 +55,7 @@ public:
 
 private:
     std::unordered_map<std::string, Miner> miners_;
+    std::unordered_map<std::string, size_t> sessionCounts_; // authorized sessions per username
     std::mutex mutex_;
 
     sqlite3 *db_;
@@ -43,33 +65,79 @@ private:
 class StratumServer : public TCPServer
 {
 public:
-    StratumServer(int port);
+    StratumServer(int port, const ServerConfig &config = ServerConfig(), const VardiffConfig &vardiff = VardiffConfig());
     ~StratumServer();
 
+    bool start() override;
     void wait();
     void stop() override;
 
     // Broadcast task to all connected miners
-    void broadcastToMiners(const std::string &task);
+    void broadcastToMiners(std::string task);
+
+    // Send the latest active job to every connected miner
+    void broadcastNotify();
 
 protected:
     void handleClient(int clientSocket) override;
 
+    // Reactor mode hooks
+    bool onClientConnected(int clientSocket) override;
+    bool onClientData(int clientSocket, LineBuffer &buffer) override;
+    void onClientDisconnected(int clientSocket) override;
+
 private:
     MinerManager minerManager;
+    VardiffConfig vardiffConfig_;
 
     std::mutex clientMutex_;
-    std::unordered_set<int> clientSockets_;
+    std::unordered_map<int, uint64_t> clientSessions_; // socket -> session id
+    SlabPool<MinerSession> sessions_;
+
+    // Recent jobs, decoded once as they appear in the Job table
+    JobCache jobs_;
+    std::thread jobWatcher_;
+    std::atomic<bool> watchingJobs_{false};
+    int64_t lastJobRow_ = 0;
+
+    // Publish Job rows newer than lastJobRow_; returns how many were added
+    size_t loadNewJobs();
+    void watchJobs();
+    // Lower the difficulty of authorized sessions whose vardiff window passed without a share
+    void retargetIdleSessions();
+
+    // Session bookkeeping; a full slab rejects the connection
+    MinerSession *openSession(int clientSocket);
+    MinerSession *findSession(int clientSocket);
+    void closeSession(int clientSocket);
 
     // Process a received Stratum message
-    void processStratumMessage(int clientSocket, const std::string &message);
-
-    // Handle specific Stratum methods
-    void handleMiningSubscribe(int clientSocket, const Json::Value &reqId);
-    void handleMiningAuthorize(int clientSocket, const Json::Value &reqId, const Json::Value &params);
-    void handleMiningExtranonceSubscribe(int clientSocket, const Json::Value &reqId);
-    void handleMiningNotify(int clientSocket);
-    void handleMiningSubmit(int clientSocket, const Json::Value &reqId, const Json::Value &params);
+    void processStratumMessage(int clientSocket, std::string_view message);
+
+    // Handle specific Stratum methods; methodHandlers_ maps each StratumMethod to one
+    using MethodHandler = void (StratumServer::*)(int clientSocket, const StratumRequest &request);
+    static const std::array<MethodHandler, static_cast<size_t>(StratumMethod::Count)> methodHandlers_;
+
+    void handleUnknownMethod(int clientSocket, const StratumRequest &request);
+    void handleMiningSubscribe(int clientSocket, const StratumRequest &request);
+    void handleMiningAuthorize(int clientSocket, const StratumRequest &request);
+    void handleMiningExtranonceSubscribe(int clientSocket, const StratumRequest &request);
+    void handleMiningNotify(int clientSocket, const StratumRequest &request = StratumRequest());
+    void handleMiningConfigure(int clientSocket, const StratumRequest &request);
+    void handleMiningSuggestDifficulty(int clientSocket, const StratumRequest &request);
+    // mining.set_difficulty followed by the current job's notify, which makes miners apply it
+    std::string buildDifficultyUpdate(double difficulty);
+
+    // The latest active job's notify line with ntime set to now (empty if there is none)
+    std::string buildNotifyMessage();
+    void handleMiningSubmit(int clientSocket, const StratumRequest &request);
+    // Runs on a validator thread; answers the submit if its session is still connected
+    void onShareValidated(const ShareSubmission &share);
+
+    // Declared last so their threads stop before the state they report into is destroyed;
+    // the validators feed the writer, so they go first
+    ShareWriter shareWriter_;
+    ShareValidatorPool validators_;
 };
 
 #endif // STRATUM_SERVER_H
@@ -5,6 +5,7 @@
 #include <string>
 #include <sqlite3.h>
 #include "block_gen.h"
+#include "coinbase_builder.h"
 #include <functional>
 
 class TaskGenerator
@@ -12,11 +13,13 @@ class TaskGenerator
 public:
     TaskGenerator(const std::string &brokers, const std::string &topic);
     bool initDatabase();
-    std::string generateCoinbaseTransaction();
-    std::string generateTask(const std::string &previousHash, double difficultyTarget);
+    // False if height cannot be encoded in the coinbase layout
+    bool generateCoinbaseTransaction(uint32_t height, CoinbaseBuilder &coinbase);
+    // Empty if no valid template can be built for height
+    std::string generateTask(const std::string &previousHash, uint32_t bits, uint32_t height);
     bool storeTask(const std::string &jobId,
                    const std::string &coinbase,
-                   const std::string &merkle,
+                   const std::vector<Hash256> &merkleBranch,
                    const std::string &prevBlock,
                    const std::string &target);
     void pushMiningTask(const std::string &task);
@@ -28,6 +31,7 @@ private:
     KafkaServer kafkaServer_;
     sqlite3 *db_;
     bool isListening_;
+    BlockGenerator blockTemplate_; // transactions and Merkle tree of the latest template
     std::function<void(const std::string &, double)> newBlockCallback_;
 };
 
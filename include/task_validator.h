@@ -1,21 +1,62 @@
 #ifndef TASK_VALIDATOR_H
 #define TASK_VALIDATOR_H
-#include <sqlite3.h>
+#include <memory>
 #include <string>
+#include <string_view>
+#include "job_cache.h"
+#include "share_writer.h"
 
+enum class ShareResult
+{
+    Accepted,
+    LowDifficulty, // header hash above the session's share target
+    Duplicate,     // same header already accepted for this job
+    Malformed,     // extranonce2, ntime or nonce of the wrong size or not hex
+};
+
+const size_t kBlockHeaderSize = 80;
+const size_t kMaxCoinbaseSize = 1024;
+const size_t kMaxValidationBatch = 64;
+
+// One mining.submit waiting for validation. Hex fields are exactly as the miner sent
+// them (short enough to stay in std::string's inline buffer).
+struct ShareSubmission
+{
+    int clientSocket = -1;
+    uint64_t sessionId = 0;
+    std::string requestId; // raw JSON id token, echoed in the response
+    std::string workerName;
+    std::shared_ptr<const MiningJob> job;
+    Uint256 target; // the session's share target when it submitted
+    std::string extranonce1;
+    std::string extranonce2;
+    std::string ntime;
+    std::string nonce;
+    ShareResult result = ShareResult::Malformed;
+};
+
+// Checks shares and hands them to the share writer for storage; each validating thread
+// owns its own instance.
 class TaskValidator
 {
 public:
-    TaskValidator();
-    bool validate(const std::string &workerName,
-                  const std::string &jobId,
-                  const std::string &extraNonce,
-                  const std::string &ntime,
-                  const std::string &nonce);
+    explicit TaskValidator(ShareWriter &writer);
+
+    // Set result on up to kMaxValidationBatch shares and record them; all headers are
+    // hashed in a single sha256dHeaders call
+    void validateBatch(ShareSubmission *shares, size_t count);
 
 private:
-    sqlite3 *db_;
-    std::string calculateHash(const std::string &extraNonce, const std::string &ntime, const std::string &nonce);
+    ShareWriter &writer_;
+
+    // Serialize the 80-byte header the miner hashed; false if an argument is malformed
+    static bool buildHeader(const MiningJob &job,
+                            std::string_view extranonce1,
+                            std::string_view extranonce2,
+                            std::string_view ntime,
+                            std::string_view nonce,
+                            uint8_t *header);
+    void recordShare(const ShareSubmission &share);
 };
 
-#endif // TASK_VALIDATOR_H
\ No newline at end of file
+#endif // TASK_VALIDATOR_H
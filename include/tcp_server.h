@@ -3,17 +3,26 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <atomic>
 #include <functional>
 #include <map>
 #include <sqlite3.h>
 #include <json/json.h>
 #include <sstream>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include "connection.h"
+#include "event_loop.h"
+#include "line_buffer.h"
 
 // HTTP请求结构
 struct HttpRequest
 {
     std::string method;
     std::string path;
+    std::string version;
+    bool keepAlive = true; // HTTP/1.1 默认保持连接，除非 Connection: close
     std::map<std::string, std::string> headers;
     std::map<std::string, std::string> parameters;
     std::string body;
@@ -23,6 +32,7 @@ struct HttpRequest
 struct HttpResponse
 {
     int status = 200;
+    bool keepAlive = true;
     std::map<std::string, std::string> headers;
     std::string content;
 
@@ -30,10 +40,35 @@ struct HttpResponse
     void setContent(const std::string &data);
 };
 
+// 连接处理模型
+enum class IoMode
+{
+    ThreadPerConnection, // 每个连接一个阻塞线程（旧模式）
+    Reactor,             // 非阻塞 socket，由事件循环统一调度
+    IoUring              // io_uring 完成队列（Linux 6.0+），不可用时回退到 Reactor
+};
+
+struct ServerConfig
+{
+    IoMode ioMode = IoMode::Reactor;
+    int reactorThreads = 0;   // Reactor 线程数，0 表示每个 CPU 核心一个
+    int listenBacklog = 4096; // listen() 队列长度，受 net.core.somaxconn 限制
+    bool pinThreads = true;   // 将 Reactor 线程绑定到固定核心（仅 Linux）
+
+    // 发送队列水位（字节）：超过高水位暂停读取该连接，降到低水位恢复；
+    // 超过上限视为慢速客户端并断开
+    size_t sendHighWatermark = 256 * 1024;
+    size_t sendLowWatermark = 64 * 1024;
+    size_t maxSendQueueBytes = 4 * 1024 * 1024;
+
+    size_t maxConnections = 65536; // 同时在线连接上限，超出的新连接直接关闭
+    int idleTimeoutSec = 300;      // 连接在该时间内未收到任何数据则断开，0 表示不超时
+};
+
 class TCPServer
 {
 public:
-    TCPServer(int port);
+    TCPServer(int port, const ServerConfig &config = ServerConfig());
     virtual ~TCPServer();
 
     virtual bool start();
@@ -42,9 +77,27 @@ public:
 protected:
     virtual void handleClient(int clientSocket);
     virtual void sendMessage(int clientSocket, const std::string &message);
+    // 发送共享的只读数据，广播时同一份 buffer 被所有连接引用
+    void sendShared(int clientSocket, const SharedBuffer &message);
+    // Reactor 模式下取得 fd 当前的连接并持有引用，非 Reactor 模式或已关闭时为空；
+    // 此后 fd 即使被关闭复用，经该引用发送的数据也只会被丢弃，不会发给新连接
+    std::shared_ptr<Connection> findConnection(int clientSocket);
+    void sendShared(Connection &conn, const SharedBuffer &message);
     virtual std::string receiveMessage(int clientSocket);
 
+    // Reactor 模式回调，均在事件循环线程中执行
+    // 返回 false 表示拒绝该连接
+    virtual bool onClientConnected(int clientSocket);
+    // 从 buffer 中消费完整的消息；返回 false 表示关闭连接
+    virtual bool onClientData(int clientSocket, LineBuffer &buffer);
+    virtual void onClientDisconnected(int clientSocket);
+
     // HTTP 请求处理
+    // 处理 buffer 中所有完整的请求（支持流水线）；返回 false 表示关闭连接
+    bool serveHttp(int clientSocket, LineBuffer &buffer);
+    // 从 data 开头取出一个完整请求（含 Content-Length / chunked 请求体）；
+    // 返回消耗的字节数，0 表示数据不完整，npos 表示请求格式错误
+    size_t takeHttpRequest(std::string_view data, HttpRequest &request);
     virtual HttpRequest parseHttpRequest(const std::string &message);
     virtual std::string formatHttpResponse(const HttpResponse &response);
     virtual void handleHttpRequest(int clientSocket, const HttpRequest &request);
@@ -53,10 +106,48 @@ protected:
     virtual void handleMinersRequest(const HttpRequest &request, HttpResponse &response);
 
     int port_;
-    int serverSocket_;
-    bool isRunning_;
+    ServerConfig config_;
+    std::vector<int> listenSockets_;
+    std::atomic<bool> isRunning_;
     std::vector<std::thread> clientThreads_;
+    std::vector<std::thread> reactorThreads_;
 
     // 数据库连接
     sqlite3 *db_;
+
+private:
+    int createListenSocket(bool reusePort);
+    void runThreaded();
+    void reapClientThreads();
+    void pinReactorThread(size_t index);
+    void runReactor(size_t index);
+    void runUring(size_t index);
+    void acceptClients(int listenSocket, EventLoop &loop, std::unordered_map<int, std::shared_ptr<Connection>> &owned);
+    std::shared_ptr<Connection> adoptClient(int clientSocket, Poller &loop,
+                                            std::unordered_map<int, std::shared_ptr<Connection>> &owned);
+    // 将已读入的数据交给处理方；返回 false 表示应关闭连接
+    bool dispatchInbound(Connection &conn, bool open);
+    void closeClient(std::unordered_map<int, std::shared_ptr<Connection>> &owned, int clientSocket);
+    void closeIdleClients(std::unordered_map<int, std::shared_ptr<Connection>> &owned);
+
+    // 发送队列，以下五个函数要求调用方持有 conn.outMutex
+    bool flushOutbound(Connection &conn);
+    int fillIovecs(Connection &conn, struct iovec *iov, int maxCount);
+    void consumeOutbound(Connection &conn, size_t written);
+    void updateInterest(Connection &conn);
+    void markClosing(Connection &conn);
+    void queueMessage(Connection &conn, const SharedBuffer &message);
+    void handleWritable(Connection &conn);
+
+    // Reactor 模式下所有连接，供任意线程按 fd 查找并发送
+    std::mutex connectionsMutex_;
+    std::unordered_map<int, std::shared_ptr<Connection>> connections_;
+
+    // 每连接一个线程模式下已结束、等待 join 的线程
+    std::mutex threadsMutex_;
+    std::vector<std::thread::id> finishedThreads_;
+
+protected:
+    // 将 socket 中可读的数据直接读入 buffer；返回 false 表示连接已关闭或出错
+    bool readFromClient(int clientSocket, LineBuffer &buffer);
 };
@@ -0,0 +1,314 @@
+#ifndef UINT256_H
+#define UINT256_H
+
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Unsigned 256-bit integer for targets and hashes, stored as four 64-bit words with
+// words[0] least significant. Comparisons are at most four word compares; everything
+// except the floating-point helpers is constexpr.
+class Uint256
+{
+public:
+    std::array<uint64_t, 4> words{};
+
+    constexpr Uint256() = default;
+    constexpr explicit Uint256(uint64_t low) : words{low, 0, 0, 0} {}
+
+    static constexpr Uint256 max() { return ~Uint256(); }
+
+    // Big-endian bytes, as targets are written
+    static constexpr Uint256 fromBigEndian(const uint8_t *bytes)
+    {
+        Uint256 value;
+        for (int i = 0; i < 32; ++i)
+        {
+            value.words[(31 - i) / 8] |= uint64_t(bytes[i]) << (8 * ((31 - i) % 8));
+        }
+        return value;
+    }
+
+    // Little-endian bytes, as SHA-256d digests are compared
+    static constexpr Uint256 fromLittleEndian(const uint8_t *bytes)
+    {
+        Uint256 value;
+        for (int i = 0; i < 32; ++i)
+        {
+            value.words[i / 8] |= uint64_t(bytes[i]) << (8 * (i % 8));
+        }
+        return value;
+    }
+
+    // Up to 64 hex digits, most significant first; parsing stops at the first non-digit
+    static constexpr Uint256 fromHex(std::string_view hex)
+    {
+        Uint256 value;
+        for (char c : hex)
+        {
+            int digit = c >= '0' && c <= '9'   ? c - '0'
+                        : c >= 'a' && c <= 'f' ? c - 'a' + 10
+                        : c >= 'A' && c <= 'F' ? c - 'A' + 10
+                                               : -1;
+            if (digit < 0)
+            {
+                break;
+            }
+            value = (value << 4) | Uint256(uint64_t(digit));
+        }
+        return value;
+    }
+
+    constexpr void toBigEndian(uint8_t *out) const
+    {
+        for (int i = 0; i < 32; ++i)
+        {
+            out[i] = uint8_t(words[(31 - i) / 8] >> (8 * ((31 - i) % 8)));
+        }
+    }
+
+    // 64 lowercase hex digits
+    std::string toHex() const
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex(64, '0');
+        for (int i = 0; i < 64; ++i)
+        {
+            hex[63 - i] = digits[(words[i / 16] >> (4 * (i % 16))) & 0xf];
+        }
+        return hex;
+    }
+
+    // Position of the highest set bit plus one (0 for zero)
+    constexpr int bits() const
+    {
+        for (int i = 3; i >= 0; --i)
+        {
+            if (words[i])
+            {
+                int bit = 63;
+                while (!(words[i] >> bit))
+                {
+                    --bit;
+                }
+                return i * 64 + bit + 1;
+            }
+        }
+        return 0;
+    }
+
+    constexpr bool isZero() const { return !(words[0] | words[1] | words[2] | words[3]); }
+
+    friend constexpr bool operator==(const Uint256 &a, const Uint256 &b)
+    {
+        return a.words[0] == b.words[0] && a.words[1] == b.words[1] && a.words[2] == b.words[2] && a.words[3] == b.words[3];
+    }
+    friend constexpr bool operator!=(const Uint256 &a, const Uint256 &b) { return !(a == b); }
+    friend constexpr bool operator<(const Uint256 &a, const Uint256 &b)
+    {
+        for (int i = 3; i >= 0; --i)
+        {
+            if (a.words[i] != b.words[i])
+            {
+                return a.words[i] < b.words[i];
+            }
+        }
+        return false;
+    }
+    friend constexpr bool operator>(const Uint256 &a, const Uint256 &b) { return b < a; }
+    friend constexpr bool operator<=(const Uint256 &a, const Uint256 &b) { return !(b < a); }
+    friend constexpr bool operator>=(const Uint256 &a, const Uint256 &b) { return !(a < b); }
+
+    constexpr Uint256 operator~() const
+    {
+        Uint256 result;
+        for (int i = 0; i < 4; ++i)
+        {
+            result.words[i] = ~words[i];
+        }
+        return result;
+    }
+
+    friend constexpr Uint256 operator|(const Uint256 &a, const Uint256 &b)
+    {
+        Uint256 result;
+        for (int i = 0; i < 4; ++i)
+        {
+            result.words[i] = a.words[i] | b.words[i];
+        }
+        return result;
+    }
+
+    constexpr Uint256 operator<<(unsigned shift) const
+    {
+        Uint256 result;
+        if (shift >= 256)
+        {
+            return result;
+        }
+        unsigned wordShift = shift / 64, bitShift = shift % 64;
+        for (unsigned i = 3; i + 1 > wordShift; --i)
+        {
+            result.words[i] = words[i - wordShift] << bitShift;
+            if (bitShift && i > wordShift)
+            {
+                result.words[i] |= words[i - wordShift - 1] >> (64 - bitShift);
+            }
+        }
+        return result;
+    }
+
+    constexpr Uint256 operator>>(unsigned shift) const
+    {
+        Uint256 result;
+        if (shift >= 256)
+        {
+            return result;
+        }
+        unsigned wordShift = shift / 64, bitShift = shift % 64;
+        for (unsigned i = 0; i + wordShift < 4; ++i)
+        {
+            result.words[i] = words[i + wordShift] >> bitShift;
+            if (bitShift && i + wordShift + 1 < 4)
+            {
+                result.words[i] |= words[i + wordShift + 1] << (64 - bitShift);
+            }
+        }
+        return result;
+    }
+
+    friend constexpr Uint256 operator+(const Uint256 &a, const Uint256 &b)
+    {
+        Uint256 result;
+        uint64_t carry = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            uint64_t sum = a.words[i] + carry;
+            carry = sum < carry;
+            result.words[i] = sum + b.words[i];
+            carry += result.words[i] < sum;
+        }
+        return result;
+    }
+
+    // Floor division by a 64-bit divisor; remainder optional
+    constexpr Uint256 divide(uint64_t divisor, uint64_t *remainder = nullptr) const
+    {
+        Uint256 quotient;
+        unsigned __int128 rest = 0;
+        for (int i = 3; i >= 0; --i)
+        {
+            rest = (rest << 64) | words[i];
+            quotient.words[i] = uint64_t(rest / divisor);
+            rest %= divisor;
+        }
+        if (remainder)
+        {
+            *remainder = uint64_t(rest);
+        }
+        return quotient;
+    }
+
+    // Product with a 64-bit factor; saturates at max() on overflow
+    constexpr Uint256 multiply(uint64_t factor) const
+    {
+        Uint256 result;
+        unsigned __int128 carry = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+            unsigned __int128 product = (unsigned __int128)words[i] * factor + carry;
+            result.words[i] = uint64_t(product);
+            carry = product >> 64;
+        }
+        return carry ? max() : result;
+    }
+
+    // floor(this / difficulty) for the exact binary value of difficulty: the double is
+    // split into a 53-bit integer mantissa and a power of two, so no precision is lost
+    // beyond the double itself. Saturates at max(); difficulty must be positive.
+    Uint256 divideByDifficulty(double difficulty) const
+    {
+        int exponent = 0;
+        double fraction = std::frexp(difficulty, &exponent); // difficulty = fraction * 2^exponent
+        uint64_t mantissa = uint64_t(std::ldexp(fraction, 53));
+        int shift = 53 - exponent; // this / difficulty = (this << shift) / mantissa
+        if (mantissa == 0)
+        {
+            return max();
+        }
+
+        uint64_t remainder = 0;
+        Uint256 quotient = divide(mantissa, &remainder);
+        if (shift <= 0)
+        {
+            return quotient >> unsigned(-shift);
+        }
+        if (shift > 200 || quotient.bits() + shift > 256)
+        {
+            return max();
+        }
+        // remainder < 2^53, so remainder << shift still fits
+        return (quotient << unsigned(shift)) + (Uint256(remainder) << unsigned(shift)).divide(mantissa);
+    }
+
+    // Approximate value, for reporting and ratios
+    double toDouble() const
+    {
+        double value = 0;
+        for (int i = 3; i >= 0; --i)
+        {
+            value = value * 18446744073709551616.0 + double(words[i]);
+        }
+        return value;
+    }
+
+    // Bitcoin compact encoding ("nBits"): a sign bit, a byte length and a 23-bit mantissa.
+    // Decoding reports values that are negative or do not fit in 256 bits.
+    static constexpr Uint256 fromCompact(uint32_t compact, bool *negative = nullptr, bool *overflow = nullptr)
+    {
+        unsigned size = compact >> 24;
+        uint64_t word = compact & 0x007fffff;
+        Uint256 value;
+        if (size <= 3)
+        {
+            value = Uint256(word >> (8 * (3 - size)));
+        }
+        else
+        {
+            value = Uint256(word) << (8 * (size - 3));
+        }
+        if (negative)
+        {
+            *negative = word != 0 && (compact & 0x00800000) != 0;
+        }
+        if (overflow)
+        {
+            *overflow = word != 0 && (size > 34 || (word > 0xff && size > 33) || (word > 0xffff && size > 32));
+        }
+        return value;
+    }
+
+    constexpr uint32_t toCompact() const
+    {
+        unsigned size = unsigned(bits() + 7) / 8;
+        uint64_t compact = size <= 3 ? words[0] << (8 * (3 - size)) : (*this >> (8 * (size - 3))).words[0];
+        // The mantissa is signed; keep its top bit clear by moving one byte into the size
+        if (compact & 0x00800000)
+        {
+            compact >>= 8;
+            ++size;
+        }
+        return uint32_t(compact) | size << 24;
+    }
+};
+
+// Difficulty-1 target (nBits 0x1d00ffff); a difficulty d share must hash at or below kDiff1Target / d
+constexpr Uint256 kDiff1Target = Uint256::fromCompact(0x1d00ffff);
+
+static_assert(kDiff1Target.toCompact() == 0x1d00ffff, "compact round trip");
+static_assert(Uint256::fromHex("00000000ffff0000000000000000000000000000000000000000000000000000") == kDiff1Target,
+              "hex and compact forms of the difficulty-1 target agree");
+
+#endif // UINT256_H
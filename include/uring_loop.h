@@ -0,0 +1,99 @@
+#ifndef URING_LOOP_H
+#define URING_LOOP_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sys/uio.h>
+#include "event_loop.h"
+
+// Request kinds, carried in the top byte of each submission's user_data
+enum UringOp : uint8_t
+{
+    URING_ACCEPT = 1,
+    URING_RECV,
+    URING_SEND,
+    URING_WAKE,
+    URING_CANCEL,
+    URING_BUFFERS,
+};
+
+struct UringEvent
+{
+    UringOp op;
+    uint32_t tag; // caller-chosen id passed when the request was queued
+    int32_t res;  // syscall-style result: bytes, new fd or -errno
+    bool more;    // a multishot request stays armed after this completion
+    int buffer;   // provided buffer holding received data, or -1
+};
+
+// Completion-based socket I/O over io_uring (Linux 6.0+), without liburing.
+// Accepts and receives are multishot, received data lands in a pool of kernel-selected
+// provided buffers, and every request queued during a loop iteration goes to the kernel
+// in a single io_uring_enter. Only the owning loop thread queues requests; other threads
+// call modify() to flag a connection, which wakes the loop through an eventfd.
+class UringLoop : public Poller
+{
+public:
+    UringLoop(unsigned entries, unsigned bufferCount, unsigned bufferSize);
+    ~UringLoop() override;
+
+    UringLoop(const UringLoop &) = delete;
+    UringLoop &operator=(const UringLoop &) = delete;
+
+    // Whether this build and kernel support everything the loop needs
+    static bool supported();
+
+    bool valid() const { return ready_; }
+
+    void accept(int listenFd);
+    void recv(int fd, uint32_t tag);
+    // iov and the data it points at must stay alive until the URING_SEND completion
+    void send(int fd, uint32_t tag, const iovec *iov, int count);
+    void cancelRecv(uint32_t tag);
+
+    // Received bytes of a completion; hand the buffer back with recycle() once consumed
+    const char *buffer(int id) const { return buffers_.get() + static_cast<size_t>(id) * bufferSize_; }
+    void recycle(int id);
+
+    // Poller: record that fd needs attention and wake the loop. The interest flags are not
+    // kept here: the loop re-reads the connection's readPaused and outbound state when it
+    // drains the descriptor, cancelling or re-arming the receive to match
+    bool modify(int fd, uint32_t flags) override;
+    // Shut the socket down so every request still pending on it completes
+    void remove(int fd) override;
+    bool submitsWrites() const override { return true; }
+
+    // Descriptors flagged through modify() since the last call
+    void takeDirty(std::vector<int> &fds);
+
+    // Submit queued requests and wait up to timeoutMs for completions; returns their count (-1 on error)
+    int wait(std::vector<UringEvent> &events, int timeoutMs);
+
+private:
+    struct Ring;
+
+    void *nextSqe();
+    bool submit(unsigned minComplete, int timeoutMs);
+    void armWake();
+    void provideBuffers(int first, unsigned count);
+
+    std::unique_ptr<Ring> ring_;
+    bool ready_ = false;
+
+    std::unique_ptr<char[]> buffers_;
+    unsigned bufferCount_ = 0;
+    unsigned bufferSize_;
+
+    int wakeFd_ = -1;
+    uint64_t wakeValue_ = 0;
+    std::atomic<bool> wakePending_{false};
+    std::atomic<std::thread::id> loopThread_{};
+    std::mutex dirtyMutex_;
+    std::vector<int> dirty_;
+};
+
+#endif // URING_LOOP_H
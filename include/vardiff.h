@@ -0,0 +1,65 @@
+#ifndef VARDIFF_H
+#define VARDIFF_H
+
+#include <chrono>
+#include <string>
+#include "uint256.h"
+
+struct VardiffConfig
+{
+    double initialDifficulty = 1.0;
+    double minDifficulty = 1.0;
+    double maxDifficulty = 1e12;
+    double targetShareSeconds = 10; // share interval each connection is steered towards
+    double retargetSeconds = 60;    // longest window between retargets
+    double variance = 0.3;          // relative rate error tolerated without a retarget
+};
+
+// Per-session variable difficulty. Counts the session's accepted shares over a window and
+// scales the difficulty so that shares arrive every targetShareSeconds: a window ends after
+// retargetSeconds, or early once it holds twice the shares it should, so a fast miner is
+// throttled within a few shares. A miner that stops finding shares never reaches a share
+// that would close its window, so a periodic retargetIdle() closes it instead. Each step
+// changes the difficulty at most fourfold.
+class VardiffController
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    void reset(const VardiffConfig &config, Clock::time_point now);
+
+    double difficulty() const { return difficulty_; }
+
+    // Target a share must meet: kDiff1Target / difficulty. Shares mined just before a
+    // retarget arrive afterwards, so for a short grace period the easier of the old and
+    // new targets applies.
+    const Uint256 &shareTarget(Clock::time_point now) const;
+
+    // Count an accepted share; true if the difficulty changed and the miner must be told
+    bool recordShare(Clock::time_point now);
+
+    // Close the window if retargetSeconds have passed without it ending on a share, which
+    // lowers the difficulty of a miner that has gone quiet; true if it changed
+    bool retargetIdle(Clock::time_point now);
+
+    // mining.suggest_difficulty, clamped to the configured range; true if it changed
+    bool suggest(double difficulty, Clock::time_point now);
+
+private:
+    // Scale the difficulty by the window's share rate and start a new window
+    bool retarget(double elapsed, Clock::time_point now);
+    bool setDifficulty(double difficulty, Clock::time_point now);
+
+    const VardiffConfig *config_ = nullptr;
+    double difficulty_ = 1.0;
+    Uint256 target_;
+    Uint256 graceTarget_;
+    Clock::time_point graceUntil_;
+    Clock::time_point windowStart_;
+    unsigned windowShares_ = 0;
+};
+
+// {"id":null,"method":"mining.set_difficulty","params":[difficulty]} with a trailing newline
+std::string buildSetDifficultyMessage(double difficulty);
+
+#endif // VARDIFF_H
@@ -1,5 +1,21 @@
 #include "block_gen.h"
+#include <cstring>
 #include <sstream>
+#include <unordered_set>
+
+namespace
+{
+// Txids are hash outputs, so any eight of their bytes are already well mixed
+struct TxidHash
+{
+    size_t operator()(const Hash256 &txid) const
+    {
+        size_t value;
+        std::memcpy(&value, txid.data(), sizeof(value));
+        return value;
+    }
+};
+}
 
 std::vector<std::string> getTransactions()
 {
@@ -11,45 +27,11 @@ std::vector<std::string> getTransactions()
     return transactions;
 }
 
-// Calculate SHA256
-std::string sha256(const std::string &data)
+Hash256 transactionId(const std::string &rawTransaction)
 {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256((unsigned char *)data.c_str(), data.size(), hash);
-    char hexStr[SHA256_DIGEST_LENGTH * 2 + 1];
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i)
-    {
-        snprintf(hexStr + i * 2, sizeof(hexStr) - i * 2, "%02x", hash[i]);
-    }
-    return std::string(hexStr);
-}
-
-// Merkle Root
-std::string calculateMerkleRoot(const std::vector<std::string> &transactions)
-{
-    if (transactions.empty())
-    {
-        return "";
-    }
-
-    std::vector<std::string> currentLevel = transactions;
-    while (currentLevel.size() > 1)
-    {
-        std::vector<std::string> nextLevel;
-        for (size_t i = 0; i < currentLevel.size(); i += 2)
-        {
-            if (i + 1 < currentLevel.size())
-            {
-                nextLevel.push_back(sha256(currentLevel[i] + currentLevel[i + 1]));
-            }
-            else
-            {
-                nextLevel.push_back(sha256(currentLevel[i]));
-            }
-        }
-        currentLevel = nextLevel;
-    }
-    return currentLevel[0];
+    Hash256 txid;
+    sha256d(reinterpret_cast<const uint8_t *>(rawTransaction.data()), rawTransaction.size(), txid.data());
+    return txid;
 }
 
 // Fetch latest block hash
@@ -85,3 +67,53 @@ std::string BlockHeader::toString() const
 
 // BlockGenerator constructor implementation
 BlockGenerator::BlockGenerator(const std::string &previousHash, const double difficulty) : previousHash(previousHash), difficulty(difficulty) {}
+
+void BlockGenerator::syncTransactions(const std::vector<Hash256> &txids)
+{
+    std::unordered_set<Hash256, TxidHash> added(txids.begin(), txids.end());
+    if (merkleTree.size() == 0)
+    {
+        merkleTree.append(Hash256{}); // coinbase slot until setCoinbase
+    }
+
+    // Index 0 is the coinbase, which is replaced rather than removed
+    std::vector<size_t> removed;
+    for (size_t i = 1; i < merkleTree.size(); ++i)
+    {
+        if (added.erase(merkleTree.leaf(i)) == 0)
+        {
+            removed.push_back(i);
+        }
+    }
+    merkleTree.remove(removed);
+
+    for (const Hash256 &txid : txids)
+    {
+        if (added.erase(txid) > 0)
+        {
+            merkleTree.append(txid);
+        }
+    }
+}
+
+void BlockGenerator::setCoinbase(const Hash256 &txid)
+{
+    if (merkleTree.size() == 0)
+    {
+        merkleTree.append(txid);
+    }
+    else
+    {
+        merkleTree.replace(0, txid);
+    }
+}
+
+Hash256 BlockGenerator::merkleRoot()
+{
+    return merkleTree.root();
+}
+
+std::vector<Hash256> BlockGenerator::merkleBranch()
+{
+    return merkleTree.coinbaseBranch();
+}
@@ -148,6 +148,7 @@ void BTC_Node::parseBlockInfo(const std::string &response)
     bestBlockHash = result["hash"].asString();
     blockHeight = result["height"].asInt();
     difficulty = result["difficulty"].asDouble();
+    bits = result["bits"].asString();
     target = result["target"].asString();
     timestamp = result["time"].asUInt();
 
@@ -166,6 +167,7 @@ void BTC_Node::parseBlockInfo(const std::string &response)
     blockInfo["height"] = blockHeight;
     blockInfo["hash"] = bestBlockHash;
     blockInfo["difficulty"] = difficulty;
+    blockInfo["bits"] = bits;
     blockInfo["target"] = target;
     blockInfo["timestamp"] = timestamp;
     blockInfo["transactions"] = Json::Value(Json::arrayValue);
@@ -0,0 +1,65 @@
+#include "coinbase_builder.h"
+#include <algorithm>
+#include "job_cache.h"
+
+namespace
+{
+void writeLE(uint8_t *out, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+}
+
+CoinbaseBuilder::CoinbaseBuilder()
+{
+    using L = CoinbaseLayout;
+    writeLE(&bytes_[L::kVersion], 1, 4);
+    bytes_[L::kInputCount] = 1;
+    writeLE(&bytes_[L::kPrevOut + 32], 0xffffffff, 4);
+
+    bytes_[L::kScriptSigLength] = L::kScriptSigSize;
+    bytes_[L::kHeightPush] = 3;
+    bytes_[L::kTimePush] = 4;
+    static const char poolTag[] = "/mining-pool/";
+    static_assert(sizeof(poolTag) - 1 == L::kPoolTagSize, "pool tag length");
+    bytes_[L::kPoolTagPush] = L::kPoolTagSize;
+    std::copy(poolTag, poolTag + L::kPoolTagSize, &bytes_[L::kPoolTagPush + 1]);
+    bytes_[L::kExtranoncePush] = L::kExtranonceSize;
+    writeLE(&bytes_[L::kSequence], 0xffffffff, 4);
+
+    bytes_[L::kOutputCount] = 1;
+    bytes_[L::kPayoutScriptLength] = L::kPayoutScriptSize;
+    static const uint8_t p2pkhPrefix[] = {0x76, 0xa9, 0x14};
+    std::copy(std::begin(p2pkhPrefix), std::end(p2pkhPrefix), &bytes_[L::kPayoutScript]);
+    bytes_[L::kPayoutPubKeyHash + 20] = 0x88;
+    bytes_[L::kPayoutPubKeyHash + 21] = 0xac;
+}
+
+bool CoinbaseBuilder::setHeight(uint32_t height)
+{
+    if (height < CoinbaseLayout::kMinHeight || height > CoinbaseLayout::kMaxHeight)
+    {
+        return false;
+    }
+    writeLE(&bytes_[CoinbaseLayout::kHeightPush + 1], height, 3);
+    return true;
+}
+
+void CoinbaseBuilder::setTime(uint32_t time)
+{
+    writeLE(&bytes_[CoinbaseLayout::kTimePush + 1], time, 4);
+}
+
+void CoinbaseBuilder::setPayout(uint64_t satoshis, const std::array<uint8_t, 20> &pubKeyHash)
+{
+    writeLE(&bytes_[CoinbaseLayout::kPayoutValue], satoshis, 8);
+    std::copy(pubKeyHash.begin(), pubKeyHash.end(), &bytes_[CoinbaseLayout::kPayoutPubKeyHash]);
+}
+
+std::string CoinbaseBuilder::toHex() const
+{
+    return ::toHex(bytes_.data(), bytes_.size());
+}
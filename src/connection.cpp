@@ -0,0 +1,26 @@
+#include "connection.h"
+
+OutboundBuffer::OutboundBuffer(std::string data)
+    : data_(std::move(data)), created_(std::chrono::steady_clock::now())
+{
+}
+
+OutboundBuffer::~OutboundBuffer()
+{
+    if (onDelivered_)
+    {
+        onDelivered_(delivered_.load(), std::chrono::nanoseconds(lastDeliveredNs_.load()));
+    }
+}
+
+void OutboundBuffer::markDelivered() const
+{
+    int64_t elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                          std::chrono::steady_clock::now() - created_)
+                          .count();
+    int64_t previous = lastDeliveredNs_.load(std::memory_order_relaxed);
+    while (elapsed > previous && !lastDeliveredNs_.compare_exchange_weak(previous, elapsed))
+    {
+    }
+    delivered_.fetch_add(1, std::memory_order_relaxed);
+}
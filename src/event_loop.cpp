@@ -0,0 +1,174 @@
+#include "event_loop.h"
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <sys/types.h>
+#include <sys/event.h>
+#include <sys/time.h>
+#endif
+
+namespace
+{
+const int kMaxEventsPerPoll = 256;
+}
+
+bool setNonBlocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0)
+    {
+        return false;
+    }
+    return fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+#ifdef __linux__
+
+static uint32_t toEpollEvents(uint32_t flags)
+{
+    uint32_t events = EPOLLRDHUP;
+    if (flags & EVENT_READ)
+        events |= EPOLLIN;
+    if (flags & EVENT_WRITE)
+        events |= EPOLLOUT;
+    return events;
+}
+
+EventLoop::EventLoop() : pollFd_(epoll_create1(EPOLL_CLOEXEC))
+{
+    if (pollFd_ < 0)
+    {
+        std::cerr << "epoll_create1 failed: " << strerror(errno) << std::endl;
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    if (pollFd_ >= 0)
+    {
+        close(pollFd_);
+    }
+}
+
+bool EventLoop::add(int fd, uint32_t flags)
+{
+    epoll_event ev{};
+    ev.events = toEpollEvents(flags);
+    ev.data.fd = fd;
+    return epoll_ctl(pollFd_, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool EventLoop::modify(int fd, uint32_t flags)
+{
+    epoll_event ev{};
+    ev.events = toEpollEvents(flags);
+    ev.data.fd = fd;
+    return epoll_ctl(pollFd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::remove(int fd)
+{
+    epoll_ctl(pollFd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+int EventLoop::poll(std::vector<IoEvent> &events, int timeoutMs)
+{
+    epoll_event ready[kMaxEventsPerPoll];
+    events.clear();
+
+    int n = epoll_wait(pollFd_, ready, kMaxEventsPerPoll, timeoutMs);
+    if (n < 0)
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        uint32_t flags = 0;
+        if (ready[i].events & (EPOLLIN | EPOLLRDHUP))
+            flags |= EVENT_READ;
+        if (ready[i].events & EPOLLOUT)
+            flags |= EVENT_WRITE;
+        if (ready[i].events & (EPOLLHUP | EPOLLERR))
+            flags |= EVENT_CLOSED;
+        events.push_back(IoEvent{ready[i].data.fd, flags});
+    }
+    return n;
+}
+
+#else // kqueue
+
+EventLoop::EventLoop() : pollFd_(kqueue())
+{
+    if (pollFd_ < 0)
+    {
+        std::cerr << "kqueue failed: " << strerror(errno) << std::endl;
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    if (pollFd_ >= 0)
+    {
+        close(pollFd_);
+    }
+}
+
+bool EventLoop::add(int fd, uint32_t flags)
+{
+    return modify(fd, flags);
+}
+
+bool EventLoop::modify(int fd, uint32_t flags)
+{
+    // Both filters are always registered; unwanted ones are just disabled
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_ADD | ((flags & EVENT_READ) ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_ADD | ((flags & EVENT_WRITE) ? EV_ENABLE : EV_DISABLE), 0, 0, nullptr);
+    return kevent(pollFd_, changes, 2, nullptr, 0, nullptr) == 0;
+}
+
+void EventLoop::remove(int fd)
+{
+    struct kevent changes[2];
+    EV_SET(&changes[0], fd, EVFILT_READ, EV_DELETE, 0, 0, nullptr);
+    EV_SET(&changes[1], fd, EVFILT_WRITE, EV_DELETE, 0, 0, nullptr);
+    kevent(pollFd_, changes, 2, nullptr, 0, nullptr);
+}
+
+int EventLoop::poll(std::vector<IoEvent> &events, int timeoutMs)
+{
+    struct kevent ready[kMaxEventsPerPoll];
+    events.clear();
+
+    timespec ts;
+    ts.tv_sec = timeoutMs / 1000;
+    ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+
+    int n = kevent(pollFd_, nullptr, 0, ready, kMaxEventsPerPoll, timeoutMs < 0 ? nullptr : &ts);
+    if (n < 0)
+    {
+        return errno == EINTR ? 0 : -1;
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        uint32_t flags = 0;
+        if (ready[i].filter == EVFILT_READ)
+            flags |= EVENT_READ;
+        if (ready[i].filter == EVFILT_WRITE)
+            flags |= EVENT_WRITE;
+        if (ready[i].flags & EV_ERROR)
+            flags |= EVENT_CLOSED;
+        events.push_back(IoEvent{static_cast<int>(ready[i].ident), flags});
+    }
+    return n;
+}
+
+#endif
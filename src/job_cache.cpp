@@ -0,0 +1,209 @@
+#include "job_cache.h"
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+
+namespace
+{
+int hexDigit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void writeHex32(char *out, uint32_t value)
+{
+    static const char digits[] = "0123456789abcdef";
+    for (int i = 0; i < 8; ++i)
+    {
+        out[i] = digits[(value >> (28 - 4 * i)) & 0x0f];
+    }
+}
+
+void appendHex32(std::string &out, uint32_t value)
+{
+    out.append(8, '0');
+    writeHex32(&out[out.size() - 8], value);
+}
+
+// Needs the generation and epoch, so it runs once publish has assigned them
+void buildNotifyMessage(MiningJob &job)
+{
+    std::string &message = job.notifyMessage;
+    message.clear();
+    message.reserve(160 + 2 * (job.prevHash.size() + job.coinbase1.size() + job.coinbase2.size()) +
+                    69 * job.merkleBranches.size());
+    message += R"({"id":null,"method":"mining.notify","params":[")";
+    message += formatJobId(job.generation);
+    message += "\",\"";
+    // Stratum's prevhash is the header bytes with each 32-bit word byte-swapped; miners
+    // swap every word back when they assemble the header
+    Hash256 prevHashWords;
+    for (size_t i = 0; i < prevHashWords.size(); i += 4)
+    {
+        std::reverse_copy(job.prevHash.begin() + i, job.prevHash.begin() + i + 4, prevHashWords.begin() + i);
+    }
+    message += toHex(prevHashWords.data(), prevHashWords.size());
+    message += "\",\"";
+    message += toHex(job.coinbase1.data(), job.coinbase1.size());
+    message += "\",\"";
+    message += toHex(job.coinbase2.data(), job.coinbase2.size());
+    message += "\",[";
+    for (size_t i = 0; i < job.merkleBranches.size(); ++i)
+    {
+        message += i > 0 ? ",\"" : "\"";
+        message += toHex(job.merkleBranches[i].data(), job.merkleBranches[i].size());
+        message += "\"";
+    }
+    message += "],\"";
+    appendHex32(message, job.version);
+    message += "\",\"";
+    appendHex32(message, job.nBits);
+    message += "\",\"";
+    job.notifyTimeOffset = message.size();
+    message.append(8, '0');
+    // Miners only need to drop their work when the block changed
+    message += job.generation == job.epochStart ? "\",true]}\n" : "\",false]}\n";
+}
+}
+
+std::string toHex(const uint8_t *data, size_t size)
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; ++i)
+    {
+        hex[i * 2] = digits[data[i] >> 4];
+        hex[i * 2 + 1] = digits[data[i] & 0x0f];
+    }
+    return hex;
+}
+
+size_t fromHex(std::string_view hex, uint8_t *out, size_t size)
+{
+    size_t count = 0;
+    while (count < size && count * 2 + 1 < hex.size())
+    {
+        int high = hexDigit(hex[count * 2]);
+        int low = hexDigit(hex[count * 2 + 1]);
+        if (high < 0 || low < 0)
+        {
+            break;
+        }
+        out[count++] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return count;
+}
+
+std::vector<Hash256> parseMerkleBranches(std::string_view merkleHex)
+{
+    std::vector<Hash256> branches;
+    size_t start = 0;
+    while (start < merkleHex.size())
+    {
+        size_t end = merkleHex.find(',', start);
+        if (end == std::string_view::npos)
+        {
+            end = merkleHex.size();
+        }
+        Hash256 branch;
+        if (fromHex(merkleHex.substr(start, end - start), branch.data(), branch.size()) == branch.size())
+        {
+            branches.push_back(branch);
+        }
+        start = end + 1;
+    }
+    return branches;
+}
+
+std::shared_ptr<MiningJob> decodeMiningJob(const std::string &jobId,
+                                           const std::string &coinbaseHex,
+                                           std::vector<Hash256> merkleBranches,
+                                           const std::string &prevBlockHex,
+                                           const std::string &targetHex)
+{
+    uint8_t coinbase[CoinbaseLayout::kSize];
+    if (coinbaseHex.size() != sizeof(coinbase) * 2 || fromHex(coinbaseHex, coinbase, sizeof(coinbase)) != sizeof(coinbase))
+    {
+        return nullptr;
+    }
+
+    auto job = std::make_shared<MiningJob>();
+    job->jobId = jobId;
+    job->coinbase1.assign(coinbase, coinbase + CoinbaseLayout::kCoinbase1Size);
+    job->coinbase2.assign(coinbase + CoinbaseLayout::kCoinbase2Offset, coinbase + sizeof(coinbase));
+    size_t prefixBlocks = job->coinbase1.size() / 64;
+    job->coinbaseMidstate = sha256Midstate(job->coinbase1.data(), prefixBlocks);
+    job->coinbase1Tail.assign(job->coinbase1.begin() + prefixBlocks * 64, job->coinbase1.end());
+
+    job->merkleBranches = std::move(merkleBranches);
+
+    // PrevBlock is stored in display order, the reverse of the header's byte order
+    fromHex(prevBlockHex, job->prevHash.data(), job->prevHash.size());
+    std::reverse(job->prevHash.begin(), job->prevHash.end());
+
+    job->target = Uint256::fromHex(targetHex);
+    job->nBits = job->target.toCompact();
+    return job;
+}
+
+JobCache::JobCache(size_t capacity) : capacity_(capacity) {}
+
+std::string formatJobId(uint64_t generation)
+{
+    char id[17];
+    snprintf(id, sizeof(id), "%llx", static_cast<unsigned long long>(generation));
+    return id;
+}
+
+bool parseJobId(std::string_view jobId, uint64_t &generation)
+{
+    const char *end = jobId.data() + jobId.size();
+    auto result = std::from_chars(jobId.data(), end, generation, 16);
+    return result.ec == std::errc() && result.ptr == end;
+}
+
+void JobCache::publish(std::shared_ptr<MiningJob> job)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    job->generation = ++lastGeneration_;
+    bool sameBlock = !jobs_.empty() && jobs_.back()->prevHash == job->prevHash;
+    job->epochStart = sameBlock ? jobs_.back()->epochStart : job->generation;
+    buildNotifyMessage(*job);
+
+    jobs_.push_back(std::move(job));
+    while (jobs_.size() > capacity_)
+    {
+        jobs_.pop_front();
+    }
+    epochStart_.store(jobs_.back()->epochStart, std::memory_order_release);
+}
+
+std::shared_ptr<const MiningJob> JobCache::find(uint64_t generation) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Generations are consecutive, so the job's position follows from its distance to the newest
+    if (generation == 0 || generation > lastGeneration_ || lastGeneration_ - generation >= jobs_.size())
+    {
+        return nullptr;
+    }
+    return jobs_[jobs_.size() - 1 - (lastGeneration_ - generation)];
+}
+
+std::shared_ptr<const MiningJob> JobCache::latest() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return jobs_.empty() ? nullptr : jobs_.back();
+}
+
+std::string notifyMessageAt(const MiningJob &job, uint32_t time)
+{
+    std::string message = job.notifyMessage;
+    writeHex32(&message[job.notifyTimeOffset], time);
+    return message;
+}
@@ -0,0 +1,78 @@
+#include "line_buffer.h"
+#include <algorithm>
+#include <cstring>
+
+LineBuffer::LineBuffer(size_t initialCapacity, size_t maxCapacity)
+    : data_(new char[initialCapacity]), capacity_(initialCapacity),
+      maxCapacity_(std::max(initialCapacity, maxCapacity))
+{
+}
+
+char *LineBuffer::writePtr(size_t minSpace)
+{
+    if (readPos_ == writePos_)
+    {
+        clear();
+    }
+
+    if (writable() < minSpace)
+    {
+        size_t unread = size();
+        if (readPos_ > 0 && capacity_ - unread >= minSpace)
+        {
+            // Wrap: move the partial line to the front
+            std::memmove(data_.get(), data_.get() + readPos_, unread);
+        }
+        else if (capacity_ < maxCapacity_)
+        {
+            size_t newCapacity = std::min(maxCapacity_, std::max(capacity_ * 2, unread + minSpace));
+            std::unique_ptr<char[]> grown(new char[newCapacity]);
+            std::memcpy(grown.get(), data_.get() + readPos_, unread);
+            data_ = std::move(grown);
+            capacity_ = newCapacity;
+        }
+        else if (readPos_ > 0)
+        {
+            std::memmove(data_.get(), data_.get() + readPos_, unread);
+        }
+        else
+        {
+            return data_.get() + writePos_;
+        }
+
+        scanPos_ -= readPos_;
+        writePos_ = unread;
+        readPos_ = 0;
+    }
+    return data_.get() + writePos_;
+}
+
+bool LineBuffer::nextLine(std::string_view &line)
+{
+    char *base = data_.get();
+    size_t from = std::max(scanPos_, readPos_);
+    const void *found = std::memchr(base + from, '\n', writePos_ - from);
+    if (!found)
+    {
+        scanPos_ = writePos_;
+        return false;
+    }
+
+    size_t end = static_cast<const char *>(found) - base;
+    size_t lineEnd = end;
+    if (lineEnd > readPos_ && base[lineEnd - 1] == '\r')
+    {
+        --lineEnd;
+    }
+
+    line = std::string_view(base + readPos_, lineEnd - readPos_);
+    readPos_ = end + 1;
+    scanPos_ = readPos_;
+    return true;
+}
+
+void LineBuffer::consume(size_t bytes)
+{
+    readPos_ += std::min(bytes, size());
+    scanPos_ = std::max(scanPos_, readPos_);
+}
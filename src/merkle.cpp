@@ -0,0 +1,227 @@
+#include "merkle.h"
+#include <algorithm>
+#include <thread>
+
+namespace
+{
+// Below this many pairs per thread, starting a thread costs more than it saves
+const size_t kMinPairsPerThread = 1024;
+const size_t kMaxMerkleThreads = 8;
+}
+
+void hashMerkleLevel(const Hash256 *nodes, size_t pairs, Hash256 *out)
+{
+    if (pairs == 0)
+    {
+        return;
+    }
+    size_t threads = std::min<size_t>({std::max(1u, std::thread::hardware_concurrency()),
+                                       kMaxMerkleThreads,
+                                       pairs / kMinPairsPerThread});
+    if (threads <= 1)
+    {
+        sha256d64(nodes[0].data(), pairs, out[0].data());
+        return;
+    }
+
+    // Chunks are multiples of eight pairs so every thread runs full multi-buffer batches
+    size_t chunk = (pairs / threads + 7) & ~size_t(7);
+    std::vector<std::thread> workers;
+    for (size_t begin = chunk; begin < pairs; begin += chunk)
+    {
+        size_t count = std::min(chunk, pairs - begin);
+        workers.emplace_back(sha256d64, nodes[2 * begin].data(), count, out[begin].data());
+    }
+    sha256d64(nodes[0].data(), std::min(chunk, pairs), out[0].data());
+    for (auto &worker : workers)
+    {
+        worker.join();
+    }
+}
+
+Hash256 calculateMerkleRoot(std::vector<Hash256> txids)
+{
+    if (txids.empty())
+    {
+        return Hash256{};
+    }
+
+    // Room for the duplicated odd node, so neither buffer reallocates while levels alternate
+    std::vector<Hash256> &level = txids;
+    level.reserve(level.size() + 1);
+    std::vector<Hash256> next;
+    next.reserve(level.size() / 2 + 2);
+
+    while (level.size() > 1)
+    {
+        if (level.size() & 1)
+        {
+            level.push_back(level.back());
+        }
+        next.resize(level.size() / 2);
+        hashMerkleLevel(level.data(), next.size(), next.data());
+        level.swap(next);
+    }
+    return level[0];
+}
+
+std::vector<Hash256> calculateCoinbaseBranch(std::vector<Hash256> txids)
+{
+    std::vector<Hash256> branch;
+    std::vector<Hash256> &level = txids;
+    level.reserve(level.size() + 1);
+    std::vector<Hash256> next;
+    next.reserve(level.size() / 2 + 2);
+
+    while (level.size() > 1)
+    {
+        branch.push_back(level[1]);
+        if (level.size() & 1)
+        {
+            level.push_back(level.back());
+        }
+        // Pair 0 holds the coinbase path; only the pairs to its right are hashed
+        next.resize(level.size() / 2);
+        hashMerkleLevel(level.data() + 2, next.size() - 1, next.data() + 1);
+        level.swap(next);
+    }
+    return branch;
+}
+
+void IncrementalMerkleTree::assign(std::vector<Hash256> leaves)
+{
+    levels_.assign(1, std::move(leaves));
+    dirty_.resize(levels_[0].size());
+    for (size_t i = 0; i < dirty_.size(); ++i)
+    {
+        dirty_[i] = i;
+    }
+}
+
+void IncrementalMerkleTree::append(const Hash256 &leaf)
+{
+    if (levels_.empty())
+    {
+        levels_.emplace_back();
+    }
+    dirty_.push_back(levels_[0].size());
+    levels_[0].push_back(leaf);
+}
+
+void IncrementalMerkleTree::replace(size_t index, const Hash256 &leaf)
+{
+    levels_[0][index] = leaf;
+    dirty_.push_back(index);
+}
+
+void IncrementalMerkleTree::remove(const std::vector<size_t> &indices)
+{
+    if (indices.empty())
+    {
+        return;
+    }
+
+    // Compact in one pass; every leaf from the first removed index on has moved
+    std::vector<Hash256> &leaves = levels_[0];
+    size_t kept = indices[0];
+    for (size_t i = indices[0], next = 0; i < leaves.size(); ++i)
+    {
+        if (next < indices.size() && indices[next] == i)
+        {
+            ++next;
+            continue;
+        }
+        leaves[kept++] = leaves[i];
+    }
+    leaves.resize(kept);
+    for (size_t i = indices[0]; i < leaves.size(); ++i)
+    {
+        dirty_.push_back(i);
+    }
+    // The new last leaf may now pair with itself
+    if (leaves.empty())
+    {
+        levels_.resize(1);
+    }
+    else
+    {
+        dirty_.push_back(leaves.size() - 1);
+    }
+}
+
+void IncrementalMerkleTree::update()
+{
+    if (dirty_.empty() || levels_.empty())
+    {
+        return;
+    }
+
+    // Size every level for the current leaf count; the nodes that appear or change
+    // pairing are all ancestors of the last leaf, which is then marked dirty
+    size_t levelCount = 1;
+    for (size_t size = levels_[0].size(); size > 1; size = (size + 1) / 2)
+    {
+        if (levels_.size() <= levelCount)
+        {
+            levels_.emplace_back();
+        }
+        levels_[levelCount++].resize((size + 1) / 2);
+    }
+    levels_.resize(levelCount);
+    if (levelCount > 1)
+    {
+        dirty_.push_back(levels_[0].size() - 1);
+    }
+
+    std::sort(dirty_.begin(), dirty_.end());
+    dirty_.erase(std::unique(dirty_.begin(), dirty_.end()), dirty_.end());
+    dirty_.erase(std::lower_bound(dirty_.begin(), dirty_.end(), levels_[0].size()), dirty_.end());
+
+    // Gather the dirty parents' children side by side so each level is one batched call
+    std::vector<size_t> parents;
+    std::vector<Hash256> children;
+    std::vector<Hash256> hashed;
+    for (size_t level = 0; level + 1 < levels_.size(); ++level)
+    {
+        const std::vector<Hash256> &nodes = levels_[level];
+        parents.clear();
+        children.clear();
+        for (size_t index : dirty_)
+        {
+            size_t parent = index / 2;
+            if (!parents.empty() && parents.back() == parent)
+            {
+                continue;
+            }
+            parents.push_back(parent);
+            children.push_back(nodes[2 * parent]);
+            children.push_back(nodes[std::min(2 * parent + 1, nodes.size() - 1)]);
+        }
+
+        hashed.resize(parents.size());
+        hashMerkleLevel(children.data(), parents.size(), hashed.data());
+        for (size_t i = 0; i < parents.size(); ++i)
+        {
+            levels_[level + 1][parents[i]] = hashed[i];
+        }
+        dirty_.swap(parents);
+    }
+    dirty_.clear();
+}
+
+Hash256 IncrementalMerkleTree::root()
+{
+    update();
+    return size() == 0 ? Hash256{} : levels_.back()[0];
+}
+
+std::vector<Hash256> IncrementalMerkleTree::coinbaseBranch()
+{
+    update();
+    std::vector<Hash256> branch;
+    for (size_t level = 0; level + 1 < levels_.size(); ++level)
+    {
+        branch.push_back(levels_[level][1]);
+    }
+    return branch;
+}
@@ -0,0 +1,81 @@
+#include "share_dedup.h"
+
+ShareDedupSet::ShareDedupSet(size_t maxEntries) : maxPerShard_(maxEntries / kShards + 1) {}
+
+// Linear probe from the fingerprint's low bits; true if it was inserted, false if present
+bool ShareDedupSet::place(std::vector<uint64_t> &slots, uint64_t fingerprint)
+{
+    size_t mask = slots.size() - 1;
+    for (size_t i = fingerprint & mask;; i = (i + 1) & mask)
+    {
+        if (slots[i] == fingerprint)
+        {
+            return false;
+        }
+        if (slots[i] == 0)
+        {
+            slots[i] = fingerprint;
+            return true;
+        }
+    }
+}
+
+ShareDedupSet::Insert ShareDedupSet::insert(uint64_t fingerprint)
+{
+    if (fingerprint == 0)
+    {
+        fingerprint = 1;
+    }
+
+    // Top bits pick the shard, low bits the slot, so the two stay independent
+    Shard &shard = shards_[fingerprint >> 58];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    if (shard.slots.empty())
+    {
+        shard.slots.assign(kInitialSlots, 0);
+    }
+    else if ((shard.count + 1) * 2 > shard.slots.size())
+    {
+        std::vector<uint64_t> grown(shard.slots.size() * 2, 0);
+        for (uint64_t existing : shard.slots)
+        {
+            if (existing)
+            {
+                place(grown, existing);
+            }
+        }
+        shard.slots.swap(grown);
+    }
+
+    if (shard.count >= maxPerShard_)
+    {
+        size_t mask = shard.slots.size() - 1;
+        for (size_t i = fingerprint & mask; shard.slots[i]; i = (i + 1) & mask)
+        {
+            if (shard.slots[i] == fingerprint)
+            {
+                return Insert::Duplicate;
+            }
+        }
+        return Insert::Full;
+    }
+
+    if (!place(shard.slots, fingerprint))
+    {
+        return Insert::Duplicate;
+    }
+    ++shard.count;
+    return Insert::New;
+}
+
+size_t ShareDedupSet::size() const
+{
+    size_t total = 0;
+    for (const Shard &shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.count;
+    }
+    return total;
+}
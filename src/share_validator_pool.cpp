@@ -0,0 +1,95 @@
+#include "share_validator_pool.h"
+#include <chrono>
+
+namespace
+{
+// Upper bound on a sleeping worker's wait; wakeups normally come from submit()
+const int kIdleWaitMs = 50;
+}
+
+ShareValidatorPool::ShareValidatorPool(size_t threads, size_t queueCapacity, ShareWriter &writer, Completion onValidated)
+    : queue_(queueCapacity), writer_(writer), onValidated_(std::move(onValidated))
+{
+    for (size_t i = 0; i < threads; ++i)
+    {
+        threads_.emplace_back(&ShareValidatorPool::run, this);
+    }
+}
+
+ShareValidatorPool::~ShareValidatorPool()
+{
+    stop();
+}
+
+bool ShareValidatorPool::submit(ShareSubmission &&share)
+{
+    if (!queue_.tryPush(std::move(share)))
+    {
+        return false;
+    }
+
+    // Pairs with the fence in run(): either the worker sees the share or we see the worker
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idleWorkers_.load(std::memory_order_relaxed) > 0)
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idleCv_.notify_one();
+    }
+    return true;
+}
+
+void ShareValidatorPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        running_ = false;
+    }
+    idleCv_.notify_all();
+    for (auto &thread : threads_)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    threads_.clear();
+}
+
+void ShareValidatorPool::run()
+{
+    TaskValidator validator(writer_);
+    std::vector<ShareSubmission> batch(kMaxValidationBatch);
+
+    for (;;)
+    {
+        size_t count = 0;
+        while (count < batch.size() && queue_.tryPop(batch[count]))
+        {
+            ++count;
+        }
+
+        if (count > 0)
+        {
+            validator.validateBatch(batch.data(), count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                onValidated_(batch[i]);
+                batch[i].job.reset();
+            }
+            continue;
+        }
+
+        // Queue drained: stopping only takes effect once nothing is left to validate
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        if (!running_)
+        {
+            break;
+        }
+        idleWorkers_.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        idleCv_.wait_for(lock, std::chrono::milliseconds(kIdleWaitMs),
+                         [this]
+                         { return !running_ || queue_.sizeApprox() > 0; });
+        idleWorkers_.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,200 @@
+#include "share_writer.h"
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+// A transaction is committed once it holds this many shares or its oldest share has
+// waited this long, whichever comes first
+const size_t kMaxTransactionShares = 4096;
+const int kMaxFlushDelayMs = 100;
+// Backlog past which each flush reports the queue depth
+const size_t kBacklogWarning = 4 * kMaxTransactionShares;
+// A batch whose transaction fails is retried with a growing delay before it is dropped
+const int kMaxWriteAttempts = 10;
+const int kRetryDelayMs = 100;
+
+bool isTransient(int rc)
+{
+    rc &= 0xff; // primary result code
+    return rc == SQLITE_BUSY || rc == SQLITE_LOCKED;
+}
+}
+
+ShareWriter::ShareWriter(size_t queueCapacity) : queue_(queueCapacity)
+{
+    // Open database
+    if (sqlite3_open("mining_pool.db", &db_) != SQLITE_OK)
+    {
+        std::cerr << "Failed to open database." << std::endl;
+    }
+    else
+    {
+        // Other processes write the same file; wait out their locks
+        sqlite3_busy_timeout(db_, 1000);
+        const char *insertShare =
+            "INSERT INTO Share (Username, JobId, IsValid, Difficulty) "
+            "VALUES (?, ?, ?, ?);";
+        if (sqlite3_prepare_v2(db_, insertShare, -1, &insertShare_, nullptr) != SQLITE_OK)
+        {
+            std::cerr << "Failed to prepare share insert: " << sqlite3_errmsg(db_) << std::endl;
+        }
+    }
+
+    thread_ = std::thread(&ShareWriter::run, this);
+}
+
+ShareWriter::~ShareWriter()
+{
+    stop();
+    sqlite3_finalize(insertShare_);
+    sqlite3_close(db_);
+}
+
+void ShareWriter::record(ShareRecord &&share)
+{
+    while (!queue_.tryPush(std::move(share)))
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    // Pairs with the fence in run(); only a full batch is worth an early wakeup
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (idle_.load(std::memory_order_relaxed) && queue_.sizeApprox() >= kMaxTransactionShares)
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        idleCv_.notify_one();
+    }
+}
+
+void ShareWriter::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(idleMutex_);
+        running_ = false;
+    }
+    idleCv_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void ShareWriter::run()
+{
+    std::vector<ShareRecord> batch(kMaxTransactionShares);
+
+    for (;;)
+    {
+        size_t count = 0;
+        while (count < batch.size() && queue_.tryPop(batch[count]))
+        {
+            ++count;
+        }
+
+        if (count > 0)
+        {
+            // Keep the batch until it commits; validation only blocks once the queue fills
+            for (int attempt = 1; !writeBatch(batch, count); ++attempt)
+            {
+                if (attempt == kMaxWriteAttempts)
+                {
+                    std::cerr << "Dropping " << count << " shares after " << attempt << " failed writes" << std::endl;
+                    dropped_.fetch_add(count, std::memory_order_relaxed);
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(kRetryDelayMs * attempt));
+            }
+            size_t backlog = queue_.sizeApprox();
+            if (backlog >= kBacklogWarning)
+            {
+                std::cerr << "Share writer behind: " << backlog << " shares queued" << std::endl;
+            }
+            if (count == batch.size())
+            {
+                continue;
+            }
+        }
+
+        // Partial batch: give more shares time to arrive. Stopping only takes effect
+        // once the queue is empty.
+        std::unique_lock<std::mutex> lock(idleMutex_);
+        if (!running_ && queue_.sizeApprox() == 0)
+        {
+            break;
+        }
+        idle_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        idleCv_.wait_for(lock, std::chrono::milliseconds(kMaxFlushDelayMs),
+                         [this]
+                         { return !running_ || queue_.sizeApprox() >= kMaxTransactionShares; });
+        idle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+bool ShareWriter::writeBatch(const std::vector<ShareRecord> &batch, size_t count)
+{
+    if (!insertShare_)
+    {
+        dropped_.fetch_add(count, std::memory_order_relaxed);
+        return true;
+    }
+
+    // IMMEDIATE takes the write lock up front, so contention shows up here, before any
+    // insert, rather than at COMMIT
+    int rc = sqlite3_exec(db_, "BEGIN IMMEDIATE;", nullptr, nullptr, nullptr);
+    if (rc != SQLITE_OK)
+    {
+        std::cerr << "Failed to begin share transaction: " << sqlite3_errmsg(db_) << std::endl;
+        return false;
+    }
+
+    size_t rejected = 0;
+    for (size_t i = 0; i < count && rc == SQLITE_OK; ++i)
+    {
+        const ShareRecord &share = batch[i];
+        std::string target = share.target.toHex();
+        sqlite3_reset(insertShare_);
+        sqlite3_bind_text(insertShare_, 1, share.workerName.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_text(insertShare_, 2, share.jobId.c_str(), -1, SQLITE_STATIC);
+        sqlite3_bind_int(insertShare_, 3, share.valid ? 1 : 0);
+        sqlite3_bind_text(insertShare_, 4, target.c_str(), -1, SQLITE_TRANSIENT);
+
+        int stepRc = sqlite3_step(insertShare_);
+        if (stepRc == SQLITE_DONE)
+        {
+            continue;
+        }
+        std::cerr << "Failed to insert share: " << sqlite3_errmsg(db_) << std::endl;
+        if (isTransient(stepRc))
+        {
+            rc = stepRc; // the whole batch is retried
+        }
+        else
+        {
+            ++rejected; // the row itself is bad; retrying would not help
+        }
+    }
+    sqlite3_clear_bindings(insertShare_);
+    sqlite3_reset(insertShare_);
+
+    if (rc == SQLITE_OK)
+    {
+        rc = sqlite3_exec(db_, "COMMIT;", nullptr, nullptr, nullptr);
+        if (rc != SQLITE_OK)
+        {
+            std::cerr << "Failed to commit " << count << " shares: " << sqlite3_errmsg(db_) << std::endl;
+        }
+    }
+    if (rc != SQLITE_OK)
+    {
+        if (!sqlite3_get_autocommit(db_))
+        {
+            sqlite3_exec(db_, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+        return false;
+    }
+    written_.fetch_add(count - rejected, std::memory_order_relaxed);
+    dropped_.fetch_add(rejected, std::memory_order_relaxed);
+    return true;
+}
@@ -0,0 +1,221 @@
+#include "stratum_parser.h"
+#include <cstring>
+#include <memory>
+#include <json/json.h>
+
+namespace
+{
+const char *skipSpace(const char *p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n'))
+    {
+        ++p;
+    }
+    return p;
+}
+
+// String without escapes; p points at the opening quote and ends past the closing one
+bool readString(const char *&p, const char *end, std::string_view &out)
+{
+    const char *start = p + 1;
+    const char *close = static_cast<const char *>(std::memchr(start, '"', end - start));
+    if (!close || std::memchr(start, '\\', close - start))
+    {
+        return false;
+    }
+    out = std::string_view(start, close - start);
+    p = close + 1;
+    return true;
+}
+
+// Number, true, false or null as its raw token
+bool readScalar(const char *&p, const char *end, std::string_view &out)
+{
+    const char *start = p;
+    if (p == end || !std::strchr("-0123456789tfn", *p))
+    {
+        return false;
+    }
+    while (p < end && *p != ',' && *p != ']' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n')
+    {
+        ++p;
+    }
+    out = std::string_view(start, p - start);
+    return true;
+}
+
+// Param value: string contents, or the raw scalar (null reads as empty, like Json::Value::asString)
+bool readValue(const char *&p, const char *end, std::string_view &out)
+{
+    if (p < end && *p == '"')
+    {
+        return readString(p, end, out);
+    }
+    if (!readScalar(p, end, out))
+    {
+        return false;
+    }
+    if (out == "null")
+    {
+        out = std::string_view();
+    }
+    return true;
+}
+
+bool readParams(const char *&p, const char *end, StratumRequest &request)
+{
+    ++p; // '['
+    p = skipSpace(p, end);
+    if (p < end && *p == ']')
+    {
+        ++p;
+        return true;
+    }
+
+    while (p < end)
+    {
+        if (request.paramCount == kMaxStratumParams)
+        {
+            return false;
+        }
+        if (!readValue(p, end, request.params[request.paramCount++]))
+        {
+            return false;
+        }
+        p = skipSpace(p, end);
+        if (p < end && *p == ',')
+        {
+            p = skipSpace(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == ']')
+        {
+            ++p;
+            return true;
+        }
+        return false;
+    }
+    return false;
+}
+}
+
+bool parseStratumRequest(std::string_view line, StratumRequest &request)
+{
+    request = StratumRequest();
+    const char *p = line.data();
+    const char *end = p + line.size();
+
+    p = skipSpace(p, end);
+    if (p == end || *p != '{')
+    {
+        return false;
+    }
+    p = skipSpace(p + 1, end);
+    if (p < end && *p == '}')
+    {
+        return skipSpace(p + 1, end) == end;
+    }
+
+    while (p < end)
+    {
+        std::string_view key;
+        if (*p != '"' || !readString(p, end, key))
+        {
+            return false;
+        }
+        p = skipSpace(p, end);
+        if (p == end || *p != ':')
+        {
+            return false;
+        }
+        p = skipSpace(p + 1, end);
+        if (p == end)
+        {
+            return false;
+        }
+
+        if (key == "params")
+        {
+            if (*p != '[' || !readParams(p, end, request))
+            {
+                return false;
+            }
+        }
+        else if (key == "id")
+        {
+            const char *start = p;
+            std::string_view ignored;
+            if (*p == '"' ? !readString(p, end, ignored) : !readScalar(p, end, ignored))
+            {
+                return false;
+            }
+            request.id = std::string_view(start, p - start);
+        }
+        else if (key == "method")
+        {
+            if (*p != '"' || !readString(p, end, request.method))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            std::string_view ignored;
+            if (!readValue(p, end, ignored))
+            {
+                return false;
+            }
+        }
+
+        p = skipSpace(p, end);
+        if (p < end && *p == ',')
+        {
+            p = skipSpace(p + 1, end);
+            continue;
+        }
+        if (p < end && *p == '}')
+        {
+            return skipSpace(p + 1, end) == end;
+        }
+        return false;
+    }
+    return false;
+}
+
+bool parseStratumRequestSlow(std::string_view line, StratumRequest &request, std::vector<std::string> &storage)
+{
+    Json::Value root;
+    Json::CharReaderBuilder builder;
+    std::string errs;
+    std::unique_ptr<Json::CharReader> reader(builder.newCharReader());
+    if (!reader->parse(line.data(), line.data() + line.size(), &root, &errs) || !root.isObject())
+    {
+        return false;
+    }
+
+    request = StratumRequest();
+    storage.clear();
+    storage.reserve(2 + kMaxStratumParams); // views below must not move
+
+    if (root.isMember("id"))
+    {
+        Json::StreamWriterBuilder writer;
+        writer["indentation"] = "";
+        storage.push_back(Json::writeString(writer, root["id"]));
+        request.id = storage.back();
+    }
+
+    storage.push_back(root["method"].isString() ? root["method"].asString() : "");
+    request.method = storage.back();
+
+    const Json::Value &params = root["params"];
+    if (params.isArray())
+    {
+        for (Json::ArrayIndex i = 0; i < params.size() && request.paramCount < kMaxStratumParams; ++i)
+        {
+            storage.push_back(params[i].isConvertibleTo(Json::stringValue) ? params[i].asString() : "");
+            request.params[request.paramCount++] = storage.back();
+        }
+    }
+    return true;
+}
@@ -1,12 +1,51 @@
 // stratum_server.cpp
 #include "stratum_server.h"
+#include <algorithm>
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <iomanip>
 #include <mutex>
 #include <unistd.h>
-#include <unordered_set>
+#include <sys/socket.h>
 #include "task_validator.h"
+#include "sha256d.h"
+
+namespace
+{
+// How often the Job table is checked for jobs created by task_gen
+const int kJobPollIntervalMs = 500;
+// Shares waiting for a validator thread; beyond this submits are refused rather than queued
+const size_t kValidationQueueCapacity = 65536;
+const size_t kShareWriteQueueCapacity = 1 << 18;
+
+// Replies are fixed text around the request id, so they are spliced rather than formatted
+const std::string_view kResultTrue = R"(,"result":true,"error":null})" "\n";
+const std::string_view kResultEmpty = R"(,"result":{},"error":null})" "\n";
+const std::string_view kAuthenticationFailed = R"(,"result":false,"error":"Authentication failed"})" "\n";
+const std::string_view kUnknownMethod = R"(,"result":null,"error":[20,"Unknown method",null]})" "\n";
+const std::string_view kServerBusy = R"(,"result":null,"error":[20,"Server busy",null]})" "\n";
+const std::string_view kMalformedShare = R"(,"result":null,"error":[20,"Malformed share",null]})" "\n";
+const std::string_view kStaleShare = R"(,"result":null,"error":[21,"Stale share",null]})" "\n";
+const std::string_view kJobNotFound = R"(,"result":null,"error":[21,"Job not found",null]})" "\n";
+const std::string_view kDuplicateShare = R"(,"result":null,"error":[22,"Duplicate share",null]})" "\n";
+const std::string_view kLowDifficultyShare = R"(,"result":null,"error":[23,"Low difficulty share",null]})" "\n";
+// The subscribe result wraps the session's extranonce1
+const std::string_view kSubscribeResult = R"(,"result":[[["mining.set_difficulty","b4b6693b72a50c7116db18d6497cac52"],)"
+                                          R"(["mining.notify","ae6812eb4cd7735a302a8a9dd95cf71f"]],")";
+const std::string_view kSubscribeResultEnd = R"(",4],"error":null})" "\n";
+static_assert(kExtranonce2Size == 4, "kSubscribeResultEnd carries the extranonce2 size");
+
+std::string reply(std::string_view id, std::string_view result)
+{
+    std::string message;
+    message.reserve(6 + id.size() + result.size() + 8);
+    message += R"({"id":)";
+    message += id;
+    message += result;
+    return message;
+}
+}
 
 Miner::Miner(const std::string &username, const std::string &password, const std::string &address)
 {
@@ -159,7 +198,8 @@ bool MinerManager::connectMiner(const std::string &username, const std::string &
     {
         std::cerr << "Failed to update miner status: " << sqlite3_errmsg(db_) << std::endl;
     }
-    miners_.emplace(loadedAddress, miner);
+    miners_.emplace(loadedUsername, miner);
+    ++sessionCounts_[loadedUsername];
     sqlite3_finalize(stmt);
     return true;
 }
@@ -168,6 +208,18 @@ bool MinerManager::disconnectMiner(const std::string &username)
 {
     std::lock_guard<std::mutex> lock(mutex_);
 
+    // A miner may run several workers under one account; it goes offline with the last one
+    auto count = sessionCounts_.find(username);
+    if (count == sessionCounts_.end())
+    {
+        return false;
+    }
+    if (--count->second > 0)
+    {
+        return true;
+    }
+    sessionCounts_.erase(count);
+
     const char *updateSQL = "UPDATE Miner SET Status = 'offline', LastSeen = CURRENT_TIMESTAMP WHERE Username = ?;";
     sqlite3_stmt *stmt;
     int result = sqlite3_prepare_v2(db_, updateSQL, -1, &stmt, nullptr);
@@ -197,272 +249,544 @@ bool MinerManager::disconnectMiner(const std::string &username)
     return true;
 }
 
-StratumServer::StratumServer(int port) : TCPServer(port), minerManager("mining_pool.db") {}
+StratumServer::StratumServer(int port, const ServerConfig &config, const VardiffConfig &vardiff)
+    : TCPServer(port, config), minerManager("mining_pool.db"), vardiffConfig_(vardiff), sessions_(config.maxConnections),
+      shareWriter_(kShareWriteQueueCapacity),
+      validators_(std::max(1u, std::thread::hardware_concurrency() / 2), kValidationQueueCapacity, shareWriter_,
+                  [this](const ShareSubmission &share)
+                  { onShareValidated(share); }) {}
 
 StratumServer::~StratumServer() {}
 
-void StratumServer::broadcastToMiners(const std::string &task)
+void StratumServer::broadcastToMiners(std::string task)
 {
-    std::lock_guard<std::mutex> lock(clientMutex_);
-    for (int clientSocket : clientSockets_)
+    std::vector<int> sockets;
     {
-        sendMessage(clientSocket, task);
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        sockets.reserve(clientSessions_.size());
+        for (const auto &entry : clientSessions_)
+        {
+            sockets.push_back(entry.first);
+        }
+    }
+
+    // Serialize once; every miner's send queue holds a reference to the same buffer
+    auto payload = std::make_shared<OutboundBuffer>(std::move(task));
+    size_t recipients = sockets.size();
+    payload->trackDelivery([recipients](size_t delivered, std::chrono::nanoseconds lastByteAfter)
+                           { std::cout << "\033[32m[>]\033[0m Broadcast delivered to " << delivered << "/" << recipients
+                                       << " miners, last byte after "
+                                       << std::chrono::duration_cast<std::chrono::microseconds>(lastByteAfter).count()
+                                       << " us" << std::endl; });
+
+    for (int clientSocket : sockets)
+    {
+        sendShared(clientSocket, payload);
     }
 }
 
-void StratumServer::handleClient(int clientSocket)
+void StratumServer::broadcastNotify()
 {
-    while (isRunning_)
+    std::string message = buildNotifyMessage();
+    if (!message.empty())
     {
-        std::string message = receiveMessage(clientSocket);
-
-        if (message.empty())
-        {
-            std::string username = "root";
-            std::cout << "Client " << username << " disconnected." << std::endl;
-            minerManager.disconnectMiner(username);
-            break;
-        }
-
-        std::cout << "Received Stratum message: " << message << std::endl;
-
-        // Process the Stratum message
-        processStratumMessage(clientSocket, message);
+        broadcastToMiners(std::move(message));
     }
+}
 
-    close(clientSocket);
+MinerSession *StratumServer::openSession(int clientSocket)
+{
     std::lock_guard<std::mutex> lock(clientMutex_);
-    clientSockets_.erase(clientSocket);
+    uint64_t id;
+    MinerSession *session = sessions_.acquire(id);
+    if (!session)
+    {
+        return nullptr;
+    }
+
+    char extranonce1[9];
+    snprintf(extranonce1, sizeof(extranonce1), "%08x", slabIndex(id));
+    session->fd = clientSocket;
+    session->username.clear();
+    session->extranonce1 = extranonce1;
+    session->vardiff.reset(vardiffConfig_, VardiffController::Clock::now());
+    session->authorized = false;
+    session->sharesSubmitted = 0;
+    session->sharesStale = 0;
+    clientSessions_[clientSocket] = id;
+    return session;
 }
 
-void StratumServer::processStratumMessage(int clientSocket, const std::string &message)
+MinerSession *StratumServer::findSession(int clientSocket)
 {
-    Json::Value root;
-    Json::CharReaderBuilder reader;
-    std::string errs;
-    std::istringstream stream(message);
+    std::lock_guard<std::mutex> lock(clientMutex_);
+    auto it = clientSessions_.find(clientSocket);
+    return it == clientSessions_.end() ? nullptr : sessions_.find(it->second);
+}
 
-    if (!Json::parseFromStream(reader, stream, &root, &errs))
+void StratumServer::closeSession(int clientSocket)
+{
+    uint64_t id;
+    MinerSession *session;
     {
-        std::cerr << "Invalid Stratum message: " << errs << std::endl;
-        sendMessage(clientSocket, R"({"id": null, "error": "Invalid message format."})");
-        return;
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        auto it = clientSessions_.find(clientSocket);
+        if (it == clientSessions_.end())
+        {
+            return;
+        }
+        id = it->second;
+        clientSessions_.erase(it);
+        session = sessions_.find(id);
     }
 
-    std::string method = root["method"].asString();
-
-    if (method == "mining.subscribe")
+    if (session && session->authorized)
+    {
+        std::cout << "Client " << session->username << " disconnected.";
+        minerManager.disconnectMiner(session->username);
+    }
+    else
     {
-        handleMiningSubscribe(clientSocket, root["id"]);
+        std::cout << "Client " << clientSocket << " disconnected.";
     }
-    else if (method == "mining.authorize")
+    if (session && session->sharesSubmitted > 0)
+    {
+        std::ostringstream stats;
+        stats << " Shares: " << session->sharesSubmitted << ", stale: " << session->sharesStale << " ("
+              << std::fixed << std::setprecision(1) << 100.0 * session->sharesStale / session->sharesSubmitted << "%)";
+        std::cout << stats.str();
+    }
+    std::cout << std::endl;
+    sessions_.release(id);
+}
+
+void StratumServer::handleClient(int clientSocket)
+{
+    if (!openSession(clientSocket))
     {
-        handleMiningAuthorize(clientSocket, root["id"], root["params"]);
+        std::cerr << "Session table full, rejecting client " << clientSocket << std::endl;
+        close(clientSocket);
+        return;
     }
-    else if (method == "mining.extranonce.subscribe")
+
+    LineBuffer buffer;
+    while (isRunning_ && !buffer.full())
     {
-        handleMiningExtranonceSubscribe(clientSocket, root["id"]);
+        char *dest = buffer.writePtr();
+        ssize_t bytesRead = recv(clientSocket, dest, buffer.writable(), 0);
+        if (bytesRead <= 0)
+        {
+            break;
+        }
+        buffer.commit(bytesRead);
+
+        std::string_view message;
+        while (buffer.nextLine(message))
+        {
+            if (message.empty())
+            {
+                continue;
+            }
+            processStratumMessage(clientSocket, message);
+        }
     }
-    else if (method == "mining.notify")
+
+    closeSession(clientSocket);
+    close(clientSocket);
+}
+
+bool StratumServer::onClientConnected(int clientSocket)
+{
+    if (!openSession(clientSocket))
     {
-        handleMiningNotify(clientSocket);
+        std::cerr << "Session table full, rejecting client " << clientSocket << std::endl;
+        return false;
     }
-    else if (method == "mining.submit")
+    return true;
+}
+
+bool StratumServer::onClientData(int clientSocket, LineBuffer &buffer)
+{
+    // Every complete line from this read is handled in one pass; a partial line stays buffered
+    std::string_view message;
+    while (buffer.nextLine(message))
     {
-        handleMiningSubmit(clientSocket, root["id"], root["params"]);
+        if (message.empty())
+        {
+            continue;
+        }
+        processStratumMessage(clientSocket, message);
     }
-    else
+    return true;
+}
+
+void StratumServer::onClientDisconnected(int clientSocket)
+{
+    closeSession(clientSocket);
+}
+
+void StratumServer::processStratumMessage(int clientSocket, std::string_view message)
+{
+    // Views into message; the jsoncpp fallback only runs for input the fast parser declines
+    StratumRequest request;
+    std::vector<std::string> storage;
+    if (!parseStratumRequest(message, request) && !parseStratumRequestSlow(message, request, storage))
     {
-        sendMessage(clientSocket, R"({"id": null, "error": "Unknown method."})");
+        std::cerr << "Invalid Stratum message: " << message << std::endl;
+        sendMessage(clientSocket, "{\"id\": null, \"error\": \"Invalid message format.\"}\n");
+        return;
     }
+
+    (this->*methodHandlers_[static_cast<size_t>(lookupStratumMethod(request.method))])(clientSocket, request);
 }
 
-void StratumServer::handleMiningSubscribe(int clientSocket, const Json::Value &reqId)
+// Indexed by StratumMethod
+const std::array<StratumServer::MethodHandler, static_cast<size_t>(StratumMethod::Count)> StratumServer::methodHandlers_ = {
+    &StratumServer::handleUnknownMethod,
+    &StratumServer::handleMiningSubmit,
+    &StratumServer::handleMiningSubscribe,
+    &StratumServer::handleMiningAuthorize,
+    &StratumServer::handleMiningExtranonceSubscribe,
+    &StratumServer::handleMiningNotify,
+    &StratumServer::handleMiningConfigure,
+    &StratumServer::handleMiningSuggestDifficulty,
+};
+
+void StratumServer::handleUnknownMethod(int clientSocket, const StratumRequest &request)
+{
+    sendMessage(clientSocket, reply(request.idOrNull(), kUnknownMethod));
+}
+
+void StratumServer::handleMiningSubscribe(int clientSocket, const StratumRequest &request)
 {
     std::cout << "Worker subscribed." << std::endl;
-    std::string sdiffSession = "b4b6693b72a50c7116db18d6497cac52";
-    std::string notifySession = "ae6812eb4cd7735a302a8a9dd95cf71f";
-    std::string extranonce1 = "08000002"; // extranonce1
-    int extranonce2Size = 4;              // extranonce2 大小
-
-    std::ostringstream oss;
-    oss << R"({"id":)" << reqId.asInt();
-    oss << R"(,"result":[[)";
-    oss << "[\"mining.set_difficulty\",\"" << sdiffSession << "\"],";
-    oss << "[\"mining.notify\",\"" << notifySession << "\"]],";
-    oss << "\"" << extranonce1 << "\"," << extranonce2Size;
-    oss << R"(],"error":null})";
-    std::string response = oss.str();
-    response += "\n";
+    MinerSession *session = findSession(clientSocket);
+    std::string_view extranonce1 = session ? std::string_view(session->extranonce1) : "08000002"; // 每个会话唯一
+
+    std::string response = reply(request.idOrNull(), kSubscribeResult);
+    response += extranonce1;
+    response += kSubscribeResultEnd;
     sendMessage(clientSocket, response);
-    std::cout << "Send message: " << response << std::endl;
+
+    // Shares are checked against the session's difficulty, so the miner learns it up front
+    if (session)
+    {
+        double difficulty;
+        {
+            std::lock_guard<std::mutex> lock(clientMutex_);
+            difficulty = session->vardiff.difficulty();
+        }
+        sendMessage(clientSocket, buildSetDifficultyMessage(difficulty));
+    }
 }
 
-void StratumServer::handleMiningAuthorize(int clientSocket, const Json::Value &reqId, const Json::Value &params)
+void StratumServer::handleMiningAuthorize(int clientSocket, const StratumRequest &request)
 {
-    std::string username = params[0].asString();
-    std::string password = params[1].asString();
+    std::string username(request.param(0));
+    std::string password(request.param(1));
 
     std::cout << "Authorizing worker " << username << std::endl;
 
-    bool success = minerManager.connectMiner(username, password);
-
-    std::ostringstream oss;
+    // Only count the login against the account once there is a session to hold it, so
+    // disconnectMiner() on close always balances it
+    MinerSession *session = findSession(clientSocket);
+    bool success = session && minerManager.connectMiner(username, password);
     if (success)
     {
-        oss << R"({"id":)" << reqId.asInt() << R"(,"result":true,"error":null})";
-    }
-    else
-    {
-        oss << R"({"id":)" << reqId.asInt() << R"(,"result":false,"error":"Authentication failed"})";
+        // Re-authorizing switches the session to the new account
+        if (session->authorized)
+        {
+            minerManager.disconnectMiner(session->username);
+        }
+        session->username = username;
+        session->authorized = true;
     }
-    std::string response = oss.str() + "\n";
-    sendMessage(clientSocket, response);
-    std::cout << "Send message: " << response << std::endl;
+
+    sendMessage(clientSocket, reply(request.idOrNull(), success ? kResultTrue : kAuthenticationFailed));
 }
 
-void StratumServer::handleMiningExtranonceSubscribe(int clientSocket, const Json::Value &reqId)
+void StratumServer::handleMiningExtranonceSubscribe(int clientSocket, const StratumRequest &request)
 {
-    std::ostringstream oss;
-    oss << R"({"id":)" << reqId.asInt() << R"(,"result":true,"error":null})";
-    std::string response = oss.str() + "\n";
-    std::cout << "Sending message: " << response << std::endl;
-    sendMessage(clientSocket, response);
-    std::cout << "Send message: " << response << std::endl;
+    sendMessage(clientSocket, reply(request.idOrNull(), kResultTrue));
     handleMiningNotify(clientSocket);
 }
 
-std::string targetToNBits(const std::string &target)
+// BIP 310: no extensions are negotiated, so answer with an empty result map
+void StratumServer::handleMiningConfigure(int clientSocket, const StratumRequest &request)
+{
+    sendMessage(clientSocket, reply(request.idOrNull(), kResultEmpty));
+}
+
+void StratumServer::handleMiningSuggestDifficulty(int clientSocket, const StratumRequest &request)
 {
-    // 去除前导零
-    size_t firstNonZero = target.find_first_not_of('0');
-    if (firstNonZero == std::string::npos)
+    double suggested = std::strtod(std::string(request.param(0)).c_str(), nullptr);
+    double changed = 0;
     {
-        return "1d00ffff";
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        auto it = clientSessions_.find(clientSocket);
+        MinerSession *session = it == clientSessions_.end() ? nullptr : sessions_.find(it->second);
+        if (session && suggested > 0 && session->vardiff.suggest(suggested, VardiffController::Clock::now()))
+        {
+            changed = session->vardiff.difficulty();
+        }
     }
 
-    // 计算有效位数
-    std::string effectiveTarget = target.substr(firstNonZero);
+    sendMessage(clientSocket, reply(request.idOrNull(), kResultTrue));
+    if (changed > 0)
+    {
+        sendMessage(clientSocket, buildDifficultyUpdate(changed));
+    }
+}
 
-    // 计算指数（第一个字节）
-    int exponent = (target.length() - firstNonZero) / 2;
+std::string StratumServer::buildDifficultyUpdate(double difficulty)
+{
+    // Miners switch to a new difficulty with the next job, and task_gen publishes one per
+    // block; resending the current job makes the change apply right away
+    return buildSetDifficultyMessage(difficulty) + buildNotifyMessage();
+}
 
-    // 取前6个有效字符作为系数（3个字节）
-    std::string coefficient = effectiveTarget.substr(0, 6);
-    while (coefficient.length() < 6)
+void StratumServer::handleMiningNotify(int clientSocket, const StratumRequest &)
+{
+    std::string message = buildNotifyMessage();
+    if (!message.empty())
     {
-        coefficient += "0";
+        std::cout << "\033[32m[>]\033[0m Sending notify: " << message;
+        sendShared(clientSocket, std::make_shared<OutboundBuffer>(std::move(message)));
     }
+}
 
-    // 组合成 nBits 格式（4字节，大端序）
-    std::stringstream ss;
-    ss << std::hex << std::setw(2) << std::setfill('0') << exponent;
-    ss << coefficient;
+std::string StratumServer::buildNotifyMessage()
+{
+    std::shared_ptr<const MiningJob> job = jobs_.latest();
+    if (!job)
+    {
+        std::cerr << "\033[31m[Error]\033[0m No active mining tasks found." << std::endl;
+        return std::string();
+    }
 
-    return ss.str();
+    return notifyMessageAt(*job, static_cast<uint32_t>(time(nullptr)));
 }
 
-void StratumServer::handleMiningNotify(int clientSocket)
+size_t StratumServer::loadNewJobs()
 {
     sqlite3_stmt *stmt = nullptr;
-    const char *sql = "SELECT JobId, Coinbase, Merkle, PrevBlock, Target "
-                      "FROM Job WHERE Status = 'active' "
-                      "ORDER BY Timestamp DESC LIMIT 1;";
+    const char *sql = "SELECT id, JobId, Coinbase, Merkle, PrevBlock, Target "
+                      "FROM Job WHERE id > ? AND Status = 'active' "
+                      "ORDER BY id DESC LIMIT 8;";
 
     if (sqlite3_prepare_v2(db_, sql, -1, &stmt, nullptr) != SQLITE_OK)
     {
         std::cerr << "\033[31m[ERROR]\033[0m Failed to prepare statement: "
                   << sqlite3_errmsg(db_) << std::endl;
-        return;
+        return 0;
     }
+    sqlite3_bind_int64(stmt, 1, lastJobRow_);
 
-    if (sqlite3_step(stmt) == SQLITE_ROW)
-    {
-        std::string jobId = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-        std::string coinbase = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
-        std::string merkle = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
-        std::string prevBlock = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
-        std::string target = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
-
-        // 计算 coinbase 分割点
-        size_t scriptStart =
-            8 +  // Version
-            2 +  // Input count
-            64 + // Previous transaction hash
-            8 +  // Previous output index
-            2;   // Script length
-
-        // coinbase2 开始位置
-        size_t scriptEnd = scriptStart +
-                           8 +  // Sequence
-                           2 +  // Output count
-                           16 + // Amount
-                           2 +  // Script length
-                           50 + // Output script
-                           8;   // Locktime
-
-        // 构造 merkle 分支数组字符串
-        std::string merkleArrayStr = "[";
-        std::istringstream merkleStream(merkle);
-        std::string hash;
-        bool first = true;
-        while (std::getline(merkleStream, hash, ','))
+    // Rows come newest first so a long backlog only loads what the cache can hold
+    std::vector<std::shared_ptr<MiningJob>> loaded;
+    while (sqlite3_step(stmt) == SQLITE_ROW)
+    {
+        lastJobRow_ = std::max<int64_t>(lastJobRow_, sqlite3_column_int64(stmt, 0));
+
+        // task_gen stores the branch as a blob of 32-byte hashes; older rows hold hex text
+        std::vector<Hash256> branches;
+        if (sqlite3_column_type(stmt, 3) == SQLITE_BLOB)
+        {
+            const Hash256 *blob = static_cast<const Hash256 *>(sqlite3_column_blob(stmt, 3));
+            branches.assign(blob, blob + sqlite3_column_bytes(stmt, 3) / sizeof(Hash256));
+        }
+        else
+        {
+            branches = parseMerkleBranches(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3)));
+        }
+        const char *jobId = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+        auto job = decodeMiningJob(jobId,
+                                   reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2)),
+                                   std::move(branches),
+                                   reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4)),
+                                   reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5)));
+        if (!job)
+        {
+            std::cerr << "\033[31m[ERROR]\033[0m Skipping job " << jobId << ": coinbase does not match the coinbase layout" << std::endl;
+            continue;
+        }
+        loaded.push_back(std::move(job));
+    }
+    sqlite3_finalize(stmt);
+
+    for (auto it = loaded.rbegin(); it != loaded.rend(); ++it)
+    {
+        jobs_.publish(*it);
+    }
+    return loaded.size();
+}
+
+void StratumServer::watchJobs()
+{
+    while (watchingJobs_)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(kJobPollIntervalMs));
+        if (loadNewJobs() > 0)
+        {
+            broadcastNotify();
+        }
+        retargetIdleSessions();
+    }
+}
+
+void StratumServer::retargetIdleSessions()
+{
+    // As in onShareValidated, connections are pinned under clientMutex_ and written to
+    // after it is released
+    std::vector<std::pair<std::shared_ptr<Connection>, double>> retargeted;
+    {
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        VardiffController::Clock::time_point now = VardiffController::Clock::now();
+        for (const auto &entry : clientSessions_)
         {
-            if (!hash.empty())
+            MinerSession *session = sessions_.find(entry.second);
+            if (!session || !session->authorized || !session->vardiff.retargetIdle(now))
             {
-                if (!first)
-                    merkleArrayStr += ",";
-                merkleArrayStr += "\"" + hash + "\"";
-                first = false;
+                continue;
+            }
+            std::shared_ptr<Connection> conn = findConnection(entry.first);
+            if (conn)
+            {
+                retargeted.emplace_back(std::move(conn), session->vardiff.difficulty());
+            }
+            else if (config_.ioMode == IoMode::ThreadPerConnection)
+            {
+                sendMessage(entry.first, buildDifficultyUpdate(session->vardiff.difficulty()));
             }
         }
-        merkleArrayStr += "]";
-
-        // 将 target 转换为 nBits 格式
-        std::string nBits = targetToNBits(target);
-
-        // 使用原始字符串构造完整的消息
-        std::ostringstream oss;
-        oss << R"({"id":null,"method":"mining.notify","params":[")"
-            << jobId << "\",\""
-            << prevBlock << "\",\""
-            << coinbase.substr(0, scriptStart) << "\",\"" // coinbase1
-            << coinbase.substr(scriptEnd) << "\","        // coinbase2
-            << merkleArrayStr << ",\""
-            << "20000000" << "\",\""
-            << nBits << "\",\""
-            << std::hex << time(nullptr) << "\","
-            << "true]}";
-
-        std::string message = oss.str() + "\n";
+    }
 
-        std::cout << "\033[32m[>]\033[0m Sending notify: " << message;
-        sendMessage(clientSocket, message);
+    for (auto &entry : retargeted)
+    {
+        sendShared(*entry.first, std::make_shared<OutboundBuffer>(buildDifficultyUpdate(entry.second)));
     }
-    else
+}
+
+void StratumServer::handleMiningSubmit(int clientSocket, const StratumRequest &request)
+{
+    std::string_view workerName = request.param(0);
+    std::string_view jobId = request.param(1);
+
+    // Shares for a superseded block are refused before any job lookup or hashing
+    uint64_t generation = 0;
+    bool knownId = parseJobId(jobId, generation);
+    bool stale = knownId && jobs_.isStale(generation);
+
+    ShareSubmission share;
+    share.job = knownId && !stale ? jobs_.find(generation) : nullptr;
     {
-        std::cerr << "\033[31m[Error]\033[0m No active mining tasks found." << std::endl;
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        auto it = clientSessions_.find(clientSocket);
+        if (it != clientSessions_.end())
+        {
+            share.sessionId = it->second;
+            if (MinerSession *session = sessions_.find(it->second))
+            {
+                ++session->sharesSubmitted;
+                session->sharesStale += stale;
+                if (share.job)
+                {
+                    share.extranonce1 = session->extranonce1;
+                    share.target = session->vardiff.shareTarget(VardiffController::Clock::now());
+                }
+            }
+        }
     }
 
-    sqlite3_finalize(stmt);
+    if (!share.job)
+    {
+        sendMessage(clientSocket, reply(request.idOrNull(), stale ? kStaleShare : kJobNotFound));
+        return;
+    }
+
+    share.clientSocket = clientSocket;
+    share.requestId = request.idOrNull();
+    share.workerName = workerName;
+    share.extranonce2 = request.param(2);
+    share.ntime = request.param(3);
+    share.nonce = request.param(4);
+
+    // Hashing and the share record happen on a validator thread, which sends the reply
+    if (!validators_.submit(std::move(share)))
+    {
+        sendMessage(clientSocket, reply(request.idOrNull(), kServerBusy));
+    }
 }
 
-void StratumServer::handleMiningSubmit(int clientSocket, const Json::Value &reqId, const Json::Value &params)
+void StratumServer::onShareValidated(const ShareSubmission &share)
 {
-    std::string workerName = params[0].asString();
-    std::string jobId = params[1].asString();
-    std::string extraNonce = params[2].asString();
-    std::string ntime = params[3].asString();
-    std::string nonce = params[4].asString();
+    std::string_view result = kMalformedShare;
+    switch (share.result)
+    {
+    case ShareResult::Accepted:
+        result = kResultTrue;
+        break;
+    case ShareResult::LowDifficulty:
+        result = kLowDifficultyShare;
+        break;
+    case ShareResult::Duplicate:
+        result = kDuplicateShare;
+        break;
+    case ShareResult::Malformed:
+        break;
+    }
+    std::string response = reply(share.requestId, result);
+
+    // closeSession needs clientMutex_ and runs before the socket is closed, so while we
+    // hold it a matching session id means the fd still belongs to the submitting miner.
+    // Its connection is pinned here and written to after the lock is released: once the
+    // fd closes, the pinned connection drops writes instead of reaching whoever reuses it.
+    std::shared_ptr<Connection> conn;
+    double retargeted = 0;
+    {
+        std::lock_guard<std::mutex> lock(clientMutex_);
+        auto it = clientSessions_.find(share.clientSocket);
+        if (it == clientSessions_.end() || it->second != share.sessionId)
+        {
+            return;
+        }
+        // Only accepted shares count towards vardiff, so rejected submits cannot raise it
+        MinerSession *session = sessions_.find(share.sessionId);
+        if (session && share.result == ShareResult::Accepted &&
+            session->vardiff.recordShare(VardiffController::Clock::now()))
+        {
+            retargeted = session->vardiff.difficulty();
+        }
+        conn = findConnection(share.clientSocket);
+        if (!conn)
+        {
+            // Thread-per-connection mode has no connection to pin, so it sends under the lock
+            if (config_.ioMode == IoMode::ThreadPerConnection)
+            {
+                sendMessage(share.clientSocket, retargeted > 0 ? response + buildDifficultyUpdate(retargeted) : response);
+            }
+            return;
+        }
+    }
 
-    std::cout << "Worker " << workerName << " submitted result for job " << jobId << std::endl;
-    TaskValidator validator;
-    bool valid = validator.validate(workerName, jobId, extraNonce, ntime, nonce);
+    if (retargeted > 0)
+    {
+        response += buildDifficultyUpdate(retargeted);
+    }
+    sendShared(*conn, std::make_shared<OutboundBuffer>(std::move(response)));
+}
 
-    std::ostringstream oss;
-    oss << R"({"id":)" << reqId.asInt() << R"(,"result":true,"error":null})";
-    std::string response = oss.str() + "\n";
-    sendMessage(clientSocket, response);
+bool StratumServer::start()
+{
+    // TCPServer::start serves until stop(), so the watcher has to be running first
+    loadNewJobs();
+    watchingJobs_ = true;
+    jobWatcher_ = std::thread(&StratumServer::watchJobs, this);
+
+    bool started = TCPServer::start();
+    watchingJobs_ = false;
+    jobWatcher_.join();
+    return started;
 }
 
 void StratumServer::wait()
@@ -476,6 +800,7 @@ void StratumServer::wait()
 void StratumServer::stop()
 {
     isRunning_ = false;
+    watchingJobs_ = false;
     TCPServer::stop();
 }
 
@@ -499,13 +824,33 @@ int main()
     {
         int stratumPort = 3333;
 
+        // 网络后端在启动时选择：STRATUM_IO_BACKEND=io_uring 启用 io_uring，不可用时回退到 epoll
+        ServerConfig config;
+        const char *backend = getenv("STRATUM_IO_BACKEND");
+        if (backend && std::string(backend) == "io_uring")
+        {
+            config.ioMode = IoMode::IoUring;
+        }
+
         std::cout << "\033[32m[启动]\033[0m Stratum 服务启动" << std::endl;
         std::cout << "├── 监听端口: " << stratumPort << std::endl;
+        std::cout << "├── 网络后端: " << (config.ioMode == IoMode::IoUring ? "io_uring" : "epoll/kqueue") << std::endl;
+        // STRATUM_MIN_DIFFICULTY 允许低于默认下限的难度（测试或 CPU 矿工）
+        VardiffConfig vardiff;
+        if (const char *minDifficulty = getenv("STRATUM_MIN_DIFFICULTY"))
+        {
+            vardiff.minDifficulty = std::max(std::strtod(minDifficulty, nullptr), 1e-12);
+        }
+
+        std::cout << "├── SHA-256d: " << sha256BackendName(sha256BatchBackend()) << " (batch), "
+                  << sha256BackendName(sha256SingleBackend()) << " (single)" << std::endl;
+        std::cout << "├── 难度: vardiff " << vardiff.minDifficulty << " - " << vardiff.maxDifficulty
+                  << ", 目标 " << vardiff.targetShareSeconds << "s/share" << std::endl;
         std::cout << "├── 数据库: mining_pool.db" << std::endl;
         std::cout << "└── 等待矿工连接..." << std::endl;
 
         // 初始化 Stratum 服务器
-        StratumServer stratumServer(stratumPort);
+        StratumServer stratumServer(stratumPort, config, vardiff);
         g_server = &stratumServer;
 
         // 启动服务
@@ -1,5 +1,8 @@
 #include "task_gen.h"
 #include "block_gen.h"
+#include "job_cache.h"
+#include "uint256.h"
+#include <charconv>
 #include <iostream>
 #include <sstream>
 #include <json/json.h>
@@ -9,29 +12,8 @@ std::string toHexString(uint64_t number, int totalBits)
     std::ostringstream oss;
     oss << std::hex << number;
     std::string hexString = oss.str();
-    while (hexString.length() < totalBits / 4)
-    {
-        hexString = "0" + hexString;
-    }
-    return hexString;
-}
-
-// Calculate Difficulty Target
-int calculateDifficultyTarget(double difficulty)
-{
-    const uint64_t maxTargetHigh = 0xFFFF;
-    const int shiftBits = 208;
-    double currentTarget = (maxTargetHigh * std::pow(2, shiftBits)) / difficulty;
-    std::string hexTarget = toHexString(static_cast<uint64_t>(currentTarget), 256);
-    int leadingZeros = 0;
-    for (char c : hexTarget)
-    {
-        if (c == '0')
-            leadingZeros++;
-        else
-            break;
-    }
-    return leadingZeros / 10;
+    size_t width = static_cast<size_t>(totalBits / 4);
+    return hexString.size() < width ? std::string(width - hexString.size(), '0') + hexString : hexString;
 }
 
 bool TaskGenerator::initDatabase()
@@ -41,7 +23,7 @@ bool TaskGenerator::initDatabase()
         "id INTEGER PRIMARY KEY AUTOINCREMENT, "
         "JobId TEXT UNIQUE NOT NULL,"
         "Coinbase TEXT NOT NULL, "
-        "Merkle TEXT NOT NULL, "
+        "Merkle BLOB NOT NULL, " // coinbase branch, concatenated 32-byte hashes
         "PrevBlock TEXT NOT NULL, "
         "Target TEXT NOT NULL, "
         "Status TEXT DEFAULT 'active',"
@@ -60,7 +42,7 @@ bool TaskGenerator::initDatabase()
 }
 
 TaskGenerator::TaskGenerator(const std::string &brokers, const std::string &topic)
-    : kafkaServer_(brokers, topic), isListening_(false)
+    : kafkaServer_(brokers, topic), isListening_(false), blockTemplate_(std::string(), 0)
 {
     // Set up database
     std::string dbPath = "mining_pool.db";
@@ -83,58 +65,52 @@ TaskGenerator::TaskGenerator(const std::string &brokers, const std::string &topi
     }
 }
 
-std::string TaskGenerator::generateCoinbaseTransaction()
+bool TaskGenerator::generateCoinbaseTransaction(uint32_t height, CoinbaseBuilder &coinbase)
 {
-    std::ostringstream oss;
-
-    // 1. 交易版本号 (4 bytes)
-    oss << "01000000";
-
-    // 2. 输入数量 (1 byte)
-    oss << "01";
-
-    // 3. 输入
-    // 3.1 空的交易ID (32 bytes)
-    oss << "0000000000000000000000000000000000000000000000000000000000000000";
-    // 3.2 输出索引 (4 bytes)
-    oss << "ffffffff";
-
-    // 3.3 coinbase 脚本
-    std::string scriptSig = "03" + toHexString(time(nullptr), 32); // 只包含时间戳
-    oss << toHexString(scriptSig.length() / 2, 8) << scriptSig;
-
-    // 3.4 序列号 (4 bytes)
-    oss << "ffffffff";
-
-    // 4. 输出数量 (1 byte)
-    oss << "01";
-
-    // 5. 输出
-    // 5.1 比特币数量 (8 bytes) - 50 BTC in satoshis
-    oss << "0000e1f505000000";
-
-    // 5.2 输出脚本
-    std::string pubKeyScript = std::string("76a914") + "0000000000000000000000000000000000000000" + "88ac";
-    oss << toHexString(pubKeyScript.length() / 2, 8) << pubKeyScript;
-
-    // 6. 锁定时间 (4 bytes)
-    oss << "00000000";
-
-    return oss.str();
+    // 字段偏移在编译期由 CoinbaseLayout 确定，extranonce 留空由矿工填充
+    if (!coinbase.setHeight(height))
+    {
+        std::cerr << "Block height " << height << " does not fit the coinbase's 3-byte BIP34 push" << std::endl;
+        return false;
+    }
+    coinbase.setTime(static_cast<uint32_t>(time(nullptr)));
+    // 50 BTC，收款地址待配置
+    coinbase.setPayout(5000000000ULL, std::array<uint8_t, 20>{});
+    return true;
 }
 
-std::string TaskGenerator::generateTask(const std::string &previousHash, double difficulty)
+std::string TaskGenerator::generateTask(const std::string &previousHash, uint32_t bits, uint32_t height)
 {
     BlockHeader blockHeader;
     blockHeader.previousHash = previousHash;
     blockHeader.timestamp = static_cast<uint32_t>(time(nullptr));
     blockHeader.nonce = 0;
-    blockHeader.difficultyTarget = calculateDifficultyTarget(difficulty);
+    // nBits must match the network's exactly; the difficulty double does not round-trip to it
+    blockHeader.difficultyTarget = bits;
+    Uint256 target = Uint256::fromCompact(bits);
 
-    std::vector<std::string> transactions = getTransactions();
-    std::string coinbaseTx = generateCoinbaseTransaction();
-    transactions.insert(transactions.begin(), coinbaseTx);
-    blockHeader.merkleRoot = calculateMerkleRoot(transactions);
+    // The coinbase comes first
+    CoinbaseBuilder coinbase;
+    if (!generateCoinbaseTransaction(height, coinbase))
+    {
+        return std::string();
+    }
+    std::string coinbaseTx = coinbase.toHex();
+    std::vector<Hash256> txids;
+    for (const std::string &transaction : getTransactions())
+    {
+        txids.push_back(transactionId(transaction));
+    }
+    // The tree persists across templates: only transactions that changed and the new
+    // coinbase are rehashed, up their paths to the root
+    blockTemplate_.syncTransactions(txids);
+    Hash256 coinbaseTxid;
+    sha256d(coinbase.data(), coinbase.size(), coinbaseTxid.data());
+    blockTemplate_.setCoinbase(coinbaseTxid);
+    // Miners only ever need the coinbase's siblings; the root here is for the block header
+    std::vector<Hash256> merkleBranch = blockTemplate_.merkleBranch();
+    Hash256 merkleRoot = blockTemplate_.merkleRoot();
+    blockHeader.merkleRoot = toHex(merkleRoot.data(), merkleRoot.size());
 
     // 生成一个业务层的 JobId
     std::ostringstream jobIdStream;
@@ -145,6 +121,11 @@ std::string TaskGenerator::generateTask(const std::string &previousHash, double
     taskJson["JobId"] = jobId;
     taskJson["previousHash"] = blockHeader.previousHash;
     taskJson["merkleRoot"] = blockHeader.merkleRoot;
+    Json::Value &branchJson = taskJson["merkleBranch"] = Json::Value(Json::arrayValue);
+    for (const Hash256 &hash : merkleBranch)
+    {
+        branchJson.append(toHex(hash.data(), hash.size()));
+    }
     taskJson["timestamp"] = blockHeader.timestamp;
     taskJson["nonce"] = blockHeader.nonce;
     taskJson["difficultyTarget"] = blockHeader.difficultyTarget;
@@ -153,8 +134,7 @@ std::string TaskGenerator::generateTask(const std::string &previousHash, double
     Json::StreamWriterBuilder writer;
     std::string taskStr = Json::writeString(writer, taskJson);
 
-    bool stored = storeTask(jobId, coinbaseTx, blockHeader.merkleRoot, blockHeader.previousHash,
-                            toHexString(static_cast<uint64_t>(blockHeader.difficultyTarget), 256));
+    bool stored = storeTask(jobId, coinbaseTx, merkleBranch, blockHeader.previousHash, target.toHex());
     if (!stored)
     {
         std::cerr << "Failed to store task with JobId: " << jobId << std::endl;
@@ -164,7 +144,7 @@ std::string TaskGenerator::generateTask(const std::string &previousHash, double
 
 bool TaskGenerator::storeTask(const std::string &jobId,
                               const std::string &coinbase,
-                              const std::string &merkle,
+                              const std::vector<Hash256> &merkleBranch,
                               const std::string &prevBlock,
                               const std::string &target)
 {
@@ -179,7 +159,9 @@ bool TaskGenerator::storeTask(const std::string &jobId,
 
     sqlite3_bind_text(stmt, 1, jobId.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 2, coinbase.c_str(), -1, SQLITE_TRANSIENT);
-    sqlite3_bind_text(stmt, 3, merkle.c_str(), -1, SQLITE_TRANSIENT);
+    // Bound as a blob; an empty branch (coinbase-only block) still satisfies NOT NULL
+    sqlite3_bind_blob(stmt, 3, merkleBranch.empty() ? "" : static_cast<const void *>(merkleBranch.data()),
+                      static_cast<int>(merkleBranch.size() * sizeof(Hash256)), SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 4, prevBlock.c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 5, target.c_str(), -1, SQLITE_TRANSIENT);
 
@@ -227,18 +209,31 @@ bool TaskGenerator::startBlockListener(const std::string &blockTopic)
         try
         {
             std::string previousHash = root["hash"].asString();
-            double difficulty = root["difficulty"].asDouble();
+            double difficulty = root["difficulty"].asDouble(); // display only
+            std::string bitsHex = root["bits"].asString();
+            uint32_t height = root["height"].asUInt() + 1; // the template builds on this block
 
             std::cout << "Parsed block info - Hash: " << previousHash << ", Difficulty: " << difficulty << std::endl;
 
+            uint32_t bits = 0;
+            auto parsed = std::from_chars(bitsHex.data(), bitsHex.data() + bitsHex.size(), bits, 16);
+            if (bitsHex.size() != 8 || parsed.ptr != bitsHex.data() + bitsHex.size())
+            {
+                std::cerr << "Block message has no valid bits: " << bitsHex << std::endl;
+                return;
+            }
+
             if (newBlockCallback_)
             {
                 newBlockCallback_(previousHash, difficulty);
             }
 
             // 生成并推送新的挖矿任务
-            std::string newTask = generateTask(previousHash, difficulty);
-            pushMiningTask(newTask);
+            std::string newTask = generateTask(previousHash, bits, height);
+            if (!newTask.empty())
+            {
+                pushMiningTask(newTask);
+            }
         }
         catch (const std::exception &e)
         {
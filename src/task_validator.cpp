@@ -1,90 +1,127 @@
 #include "task_validator.h"
+#include "sha256d.h"
+#include <algorithm>
 #include <string>
-#include <sstream>
-#include <iomanip>
-#include <openssl/sha.h>
-#include <iostream>
-#include <ctime>
 
-TaskValidator::TaskValidator()
+TaskValidator::TaskValidator(ShareWriter &writer) : writer_(writer) {}
+
+namespace
+{
+// Stratum sends 32-bit header fields as big-endian hex; the header stores them little-endian
+bool readHexWord(std::string_view hex, uint8_t *out)
 {
-    // Open database
-    int result = sqlite3_open("mining_pool.db", &db_);
-    if (result != SQLITE_OK)
+    uint8_t word[4];
+    if (hex.size() != 8 || fromHex(hex, word, 4) != 4)
     {
-        std::cerr << "Failed to open database." << std::endl;
+        return false;
     }
+    out[0] = word[3];
+    out[1] = word[2];
+    out[2] = word[1];
+    out[3] = word[0];
+    return true;
 }
 
-bool TaskValidator::validate(const std::string &workerName,
-                             const std::string &jobId,
-                             const std::string &extraNonce,
-                             const std::string &ntime,
-                             const std::string &nonce)
+void writeWord(uint32_t value, uint8_t *out)
 {
-    std::string hash = calculateHash(extraNonce, ntime, nonce);
-    std::string target;
-    bool isValid = false;
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+    out[2] = static_cast<uint8_t>(value >> 16);
+    out[3] = static_cast<uint8_t>(value >> 24);
+}
+}
 
-    // 获取任务目标值
-    sqlite3_stmt *stmt = nullptr;
-    const char *query = "SELECT Target FROM Job WHERE JobId = ?;";
-    if (sqlite3_prepare_v2(db_, query, -1, &stmt, nullptr) == SQLITE_OK)
+bool TaskValidator::buildHeader(const MiningJob &job,
+                                std::string_view extranonce1,
+                                std::string_view extranonce2,
+                                std::string_view ntime,
+                                std::string_view nonce,
+                                uint8_t *header)
+{
+    // coinbase1 + extranonce1 + extranonce2 + coinbase2, resuming after coinbase1's whole
+    // blocks so only the variable tail is hashed per share
+    uint8_t tail[kMaxCoinbaseSize];
+    size_t tailSize = job.coinbase1Tail.size() + kExtranonce1Size + kExtranonce2Size + job.coinbase2.size();
+    if (tailSize > sizeof(tail) ||
+        extranonce1.size() != kExtranonce1Size * 2 || extranonce2.size() != kExtranonce2Size * 2)
     {
-        sqlite3_bind_text(stmt, 1, jobId.c_str(), -1, SQLITE_STATIC);
-        if (sqlite3_step(stmt) == SQLITE_ROW)
-        {
-            target = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
-        }
-        sqlite3_finalize(stmt);
+        return false;
     }
-    else
+    uint8_t *p = std::copy(job.coinbase1Tail.begin(), job.coinbase1Tail.end(), tail);
+    if (fromHex(extranonce1, p, kExtranonce1Size) != kExtranonce1Size ||
+        fromHex(extranonce2, p + kExtranonce1Size, kExtranonce2Size) != kExtranonce2Size)
     {
-        std::cerr << "Failed to prepare select statement: " << sqlite3_errmsg(db_) << std::endl;
         return false;
     }
+    std::copy(job.coinbase2.begin(), job.coinbase2.end(), p + kExtranonce1Size + kExtranonce2Size);
 
-    isValid = hash < target;
-
-    // 记录share
-    const char *insertShare =
-        "INSERT INTO Share (Username, JobId, IsValid, Difficulty) "
-        "VALUES (?, ?, ?, ?);";
-
-    if (sqlite3_prepare_v2(db_, insertShare, -1, &stmt, nullptr) == SQLITE_OK)
+    // Fold the coinbase hash up the branch: root = SHA256d(root || branch)
+    uint8_t pair[64];
+    sha256dResume(job.coinbaseMidstate, tail, tailSize, pair);
+    for (const Hash256 &branch : job.merkleBranches)
     {
-        sqlite3_bind_text(stmt, 1, workerName.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_text(stmt, 2, jobId.c_str(), -1, SQLITE_STATIC);
-        sqlite3_bind_int(stmt, 3, isValid ? 1 : 0);
-        sqlite3_bind_text(stmt, 4, target.c_str(), -1, SQLITE_STATIC);
-
-        if (sqlite3_step(stmt) != SQLITE_DONE)
-        {
-            std::cerr << "Failed to insert share: " << sqlite3_errmsg(db_) << std::endl;
-        }
-        sqlite3_finalize(stmt);
+        std::copy(branch.begin(), branch.end(), pair + 32);
+        sha256d(pair, sizeof(pair), pair);
     }
 
-    return isValid;
+    // version | prevhash | merkle root | ntime | nBits | nonce
+    writeWord(job.version, header);
+    std::copy(job.prevHash.begin(), job.prevHash.end(), header + 4);
+    std::copy(pair, pair + 32, header + 36);
+    if (!readHexWord(ntime, header + 68))
+    {
+        return false;
+    }
+    writeWord(job.nBits, header + 72);
+    return readHexWord(nonce, header + 76);
 }
 
-std::string TaskValidator::calculateHash(const std::string &extraNonce, const std::string &ntime, const std::string &nonce)
+void TaskValidator::validateBatch(ShareSubmission *shares, size_t count)
 {
-    std::string data = extraNonce + ntime + nonce;
+    uint8_t headers[kMaxValidationBatch][kBlockHeaderSize];
+    uint8_t digests[kMaxValidationBatch][32];
+    size_t owner[kMaxValidationBatch];
+    size_t built = 0;
 
-    // First SHA256
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256(reinterpret_cast<const unsigned char *>(data.c_str()), data.size(), hash);
+    for (size_t i = 0; i < count && i < kMaxValidationBatch; ++i)
+    {
+        ShareSubmission &share = shares[i];
+        if (buildHeader(*share.job, share.extranonce1, share.extranonce2, share.ntime, share.nonce, headers[built]))
+        {
+            owner[built++] = i;
+        }
+        else
+        {
+            share.result = ShareResult::Malformed;
+        }
+    }
 
-    // Second SHA256
-    unsigned char doubleHash[SHA256_DIGEST_LENGTH];
-    SHA256(hash, SHA256_DIGEST_LENGTH, doubleHash);
+    sha256dHeaders(headers[0], built, digests[0]);
 
-    // to Hex
-    std::ostringstream oss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; i++)
+    for (size_t k = 0; k < built; ++k)
     {
-        oss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(doubleHash[i]);
+        // The digest is a little-endian 256-bit number
+        ShareSubmission &share = shares[owner[k]];
+        Uint256 hash = Uint256::fromLittleEndian(digests[k]);
+        share.result = hash <= share.target ? ShareResult::Accepted : ShareResult::LowDifficulty;
+        // The header covers extranonce1/2, ntime and nonce, so its hash's low word is a
+        // uniform fingerprint of the share. A full set stops detecting rather than rejecting.
+        if (share.result == ShareResult::Accepted &&
+            share.job->acceptedShares.insert(hash.words[0]) == ShareDedupSet::Insert::Duplicate)
+        {
+            share.result = ShareResult::Duplicate;
+        }
+        recordShare(share);
     }
-    return oss.str();
+}
+
+void TaskValidator::recordShare(const ShareSubmission &share)
+{
+    // 记录share
+    ShareRecord record;
+    record.workerName = share.workerName;
+    record.jobId = share.job->jobId;
+    record.valid = share.result == ShareResult::Accepted;
+    record.target = share.target;
+    writer_.record(std::move(record));
 }
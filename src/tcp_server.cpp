@@ -1,8 +1,59 @@
 #include "tcp_server.h"
 #include <iostream>
 #include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <strings.h>
 #include <unistd.h>
+#include <sys/uio.h>
+#include <pthread.h>
 #include <arpa/inet.h>
+#include "uring_loop.h"
+
+namespace
+{
+const int kReactorPollMs = 500;         // 事件循环等待超时，用于检查停止标志
+const int kMaxIovecs = 64;              // 单次 writev 合并的最大消息数
+const size_t kMaxReadPerEvent = 65536;  // 单次可读事件最多读取的字节数，避免单个连接饿死其他连接
+const int kIdleCheckIntervalSec = 1;    // 空闲连接扫描间隔
+
+const unsigned kUringEntries = 4096;    // io_uring 提交队列长度
+const unsigned kUringBuffers = 1024;    // 每个 Reactor 的接收缓冲区个数（由内核按需选取）
+const unsigned kUringBufferSize = 4096; // 单个接收缓冲区大小
+
+// io_uring 模式下一个连接的在途请求，仅由所属事件循环线程访问
+struct UringSlot
+{
+    std::shared_ptr<Connection> conn;
+    bool recvArmed = false;
+    bool recvCancelling = false;
+    bool sending = false;
+    iovec iov[kMaxIovecs];
+    std::vector<SharedBuffer> inflight; // 在途 writev 引用的数据，完成前保持存活
+};
+
+// 按名称查找请求头（不区分大小写）
+std::string headerValue(const HttpRequest &request, const char *name)
+{
+    for (const auto &header : request.headers)
+    {
+        if (strcasecmp(header.first.c_str(), name) == 0)
+        {
+            return header.second;
+        }
+    }
+    return "";
+}
+
+bool containsToken(std::string value, const char *token)
+{
+    for (char &c : value)
+    {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return value.find(token) != std::string::npos;
+}
+}
 
 void HttpResponse::setStatus(int code)
 {
@@ -14,8 +65,8 @@ void HttpResponse::setContent(const std::string &data)
     content = data;
 }
 
-TCPServer::TCPServer(int port)
-    : port_(port), serverSocket_(-1), isRunning_(false)
+TCPServer::TCPServer(int port, const ServerConfig &config)
+    : port_(port), config_(config), isRunning_(false)
 {
     if (sqlite3_open("mining_pool.db", &db_) != SQLITE_OK)
     {
@@ -29,13 +80,23 @@ TCPServer::~TCPServer()
     stop();
 }
 
-bool TCPServer::start()
+int TCPServer::createListenSocket(bool reusePort)
 {
-    serverSocket_ = socket(AF_INET, SOCK_STREAM, 0);
-    if (serverSocket_ < 0)
+    int listenSocket = socket(AF_INET, SOCK_STREAM, 0);
+    if (listenSocket < 0)
     {
         std::cerr << "Failed to create socket." << std::endl;
-        return false;
+        return -1;
+    }
+
+    // 重启后立即重新绑定端口，避免 TIME_WAIT 导致矿工重连失败
+    int enable = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (reusePort && setsockopt(listenSocket, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) < 0)
+    {
+        std::cerr << "Failed to enable SO_REUSEPORT: " << strerror(errno) << std::endl;
+        close(listenSocket);
+        return -1;
     }
 
     sockaddr_in serverAddr{};
@@ -43,26 +104,96 @@ bool TCPServer::start()
     serverAddr.sin_addr.s_addr = INADDR_ANY;
     serverAddr.sin_port = htons(port_);
 
-    if (bind(serverSocket_, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) < 0)
+    if (bind(listenSocket, (struct sockaddr *)&serverAddr, sizeof(serverAddr)) < 0)
     {
         std::cerr << "Bind failed." << std::endl;
-        return false;
+        close(listenSocket);
+        return -1;
     }
 
-    if (listen(serverSocket_, 5) < 0)
+    if (listen(listenSocket, config_.listenBacklog) < 0)
     {
         std::cerr << "Listen failed." << std::endl;
-        return false;
+        close(listenSocket);
+        return -1;
+    }
+    return listenSocket;
+}
+
+bool TCPServer::start()
+{
+    // 对端关闭后继续写入不应终止进程
+    signal(SIGPIPE, SIG_IGN);
+
+    if (config_.ioMode == IoMode::IoUring && !UringLoop::supported())
+    {
+        std::cerr << "io_uring is not available, falling back to epoll." << std::endl;
+        config_.ioMode = IoMode::Reactor;
+    }
+
+    size_t reactors = 1;
+    if (config_.ioMode != IoMode::ThreadPerConnection)
+    {
+        reactors = config_.reactorThreads > 0 ? config_.reactorThreads
+                                              : std::max(1u, std::thread::hardware_concurrency());
+    }
+
+#ifdef __linux__
+    // Linux 内核按连接哈希在 SO_REUSEPORT 组内分发，每个 Reactor 拥有独立的监听 socket
+    size_t listeners = reactors;
+#else
+    // 其他平台的 SO_REUSEPORT 不做负载均衡，所有 Reactor 共享一个监听 socket
+    size_t listeners = 1;
+#endif
+
+    for (size_t i = 0; i < listeners; ++i)
+    {
+        int listenSocket = createListenSocket(listeners > 1);
+        if (listenSocket < 0)
+        {
+            stop();
+            return false;
+        }
+        listenSockets_.push_back(listenSocket);
     }
 
     isRunning_ = true;
     std::cout << "Server started on port " << port_ << std::endl;
 
+    if (config_.ioMode == IoMode::ThreadPerConnection)
+    {
+        runThreaded();
+        return true;
+    }
+
+    bool uring = config_.ioMode == IoMode::IoUring;
+    std::cout << "Running " << reactors << (uring ? " io_uring" : " reactor") << " thread(s), backlog "
+              << config_.listenBacklog << std::endl;
+    void (TCPServer::*run)(size_t) = uring ? &TCPServer::runUring : &TCPServer::runReactor;
+    for (size_t i = 1; i < reactors; ++i)
+    {
+        reactorThreads_.emplace_back(run, this, i);
+    }
+    (this->*run)(0);
+
+    for (auto &thread : reactorThreads_)
+    {
+        if (thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    reactorThreads_.clear();
+    return true;
+}
+
+void TCPServer::runThreaded()
+{
     while (isRunning_)
     {
         sockaddr_in clientAddr{};
         socklen_t clientLen = sizeof(clientAddr);
-        int clientSocket = accept(serverSocket_, (struct sockaddr *)&clientAddr, &clientLen);
+        int clientSocket = accept(listenSockets_[0], (struct sockaddr *)&clientAddr, &clientLen);
         if (clientSocket < 0)
         {
             if (isRunning_)
@@ -72,20 +203,808 @@ bool TCPServer::start()
             continue;
         }
 
+        reapClientThreads();
+        if (clientThreads_.size() >= config_.maxConnections)
+        {
+            std::cerr << "Too many connections, rejecting client." << std::endl;
+            close(clientSocket);
+            continue;
+        }
+
+        if (config_.idleTimeoutSec > 0)
+        {
+            // 阻塞读超时后 recv 返回错误，由 handleClient 正常结束连接
+            timeval timeout{};
+            timeout.tv_sec = config_.idleTimeoutSec;
+            setsockopt(clientSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        }
+
         std::cout << "New client connected." << std::endl;
-        clientThreads_.emplace_back(&TCPServer::handleClient, this, clientSocket);
+        clientThreads_.emplace_back([this, clientSocket]
+                                    {
+            handleClient(clientSocket);
+            std::lock_guard<std::mutex> lock(threadsMutex_);
+            finishedThreads_.push_back(std::this_thread::get_id()); });
+    }
+}
+
+void TCPServer::reapClientThreads()
+{
+    std::vector<std::thread::id> finished;
+    {
+        std::lock_guard<std::mutex> lock(threadsMutex_);
+        finished.swap(finishedThreads_);
+    }
+
+    for (const std::thread::id &id : finished)
+    {
+        for (size_t i = 0; i < clientThreads_.size(); ++i)
+        {
+            if (clientThreads_[i].get_id() == id)
+            {
+                clientThreads_[i].join();
+                clientThreads_[i] = std::move(clientThreads_.back());
+                clientThreads_.pop_back();
+                break;
+            }
+        }
+    }
+}
+
+void TCPServer::pinReactorThread(size_t index)
+{
+#ifdef __linux__
+    if (config_.pinThreads)
+    {
+        unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % cores, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0)
+        {
+            std::cerr << "Failed to pin reactor " << index << " to a core." << std::endl;
+        }
+    }
+#endif
+}
+
+void TCPServer::runReactor(size_t index)
+{
+    pinReactorThread(index);
+
+    EventLoop loop;
+    int listenSocket = listenSockets_[index % listenSockets_.size()];
+    if (!loop.valid() || !setNonBlocking(listenSocket) || !loop.add(listenSocket, EVENT_READ))
+    {
+        std::cerr << "Failed to set up event loop." << std::endl;
+        isRunning_ = false;
+        return;
+    }
+
+    // 本 Reactor 拥有的连接，仅由事件循环线程访问
+    std::unordered_map<int, std::shared_ptr<Connection>> owned;
+    std::vector<IoEvent> events;
+    auto lastIdleCheck = std::chrono::steady_clock::now();
+
+    while (isRunning_)
+    {
+        if (loop.poll(events, kReactorPollMs) < 0)
+        {
+            std::cerr << "Event loop poll failed." << std::endl;
+            break;
+        }
+
+        for (const IoEvent &event : events)
+        {
+            if (event.fd == listenSocket)
+            {
+                acceptClients(listenSocket, loop, owned);
+                continue;
+            }
+
+            auto it = owned.find(event.fd);
+            if (it == owned.end())
+            {
+                continue;
+            }
+            Connection &conn = *it->second;
+
+            if (event.flags & EVENT_WRITE)
+            {
+                handleWritable(conn);
+            }
+
+            bool open = true;
+            if (event.flags & (EVENT_READ | EVENT_CLOSED))
+            {
+                size_t before = conn.inbound.size();
+                open = readFromClient(conn.fd, conn.inbound);
+                if (conn.inbound.size() != before)
+                {
+                    conn.lastActive = std::chrono::steady_clock::now();
+                }
+            }
+            if (!dispatchInbound(conn, open) || (event.flags & EVENT_CLOSED))
+            {
+                closeClient(owned, event.fd);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (config_.idleTimeoutSec > 0 && now - lastIdleCheck >= std::chrono::seconds(kIdleCheckIntervalSec))
+        {
+            lastIdleCheck = now;
+            closeIdleClients(owned);
+        }
+    }
+
+    while (!owned.empty())
+    {
+        closeClient(owned, owned.begin()->first);
+    }
+}
+
+void TCPServer::runUring(size_t index)
+{
+    pinReactorThread(index);
+
+    // 在途请求的状态按连接序号索引：fd 被复用后，旧连接迟到的完成事件仍能对上原来的连接
+    std::unordered_map<uint32_t, UringSlot> slots;
+    std::unordered_map<int, uint32_t> slotByFd;
+    uint32_t nextTag = 0;
+
+    UringLoop ring(kUringEntries, kUringBuffers, kUringBufferSize);
+    if (!ring.valid())
+    {
+        std::cerr << "Failed to set up io_uring, reactor " << index << " falls back to epoll." << std::endl;
+        runReactor(index);
+        return;
+    }
+
+    int listenSocket = listenSockets_[index % listenSockets_.size()];
+    ring.accept(listenSocket);
+
+    std::unordered_map<int, std::shared_ptr<Connection>> owned;
+    std::vector<UringEvent> events;
+    std::vector<int> dirty;
+    auto lastIdleCheck = std::chrono::steady_clock::now();
+
+    // 按连接当前状态补发请求：有待发数据且无在途发送时提交 writev，
+    // 读暂停时取消接收，恢复或即将关闭时重新挂上接收以便读到 EOF
+    auto reconcile = [&](uint32_t tag, UringSlot &slot)
+    {
+        Connection &conn = *slot.conn;
+        bool wantRead;
+        {
+            std::lock_guard<std::mutex> lock(conn.outMutex);
+            wantRead = !conn.readPaused || conn.closing;
+            if (!conn.closing && !slot.sending && !conn.outbound.empty())
+            {
+                int count = fillIovecs(conn, slot.iov, kMaxIovecs);
+                slot.inflight.assign(conn.outbound.begin(), conn.outbound.begin() + count);
+                ring.send(conn.fd, tag, slot.iov, count);
+                slot.sending = true;
+            }
+        }
+
+        if (wantRead && !slot.recvArmed)
+        {
+            ring.recv(conn.fd, tag);
+            slot.recvArmed = true;
+        }
+        else if (!wantRead && slot.recvArmed && !slot.recvCancelling)
+        {
+            ring.cancelRecv(tag);
+            slot.recvCancelling = true;
+        }
+    };
+
+    while (isRunning_)
+    {
+        // 其他线程排入发送队列的连接，在本轮 io_uring_enter 中一并提交
+        ring.takeDirty(dirty);
+        for (int fd : dirty)
+        {
+            auto tag = slotByFd.find(fd);
+            if (owned.count(fd) && tag != slotByFd.end())
+            {
+                reconcile(tag->second, slots[tag->second]);
+            }
+        }
+
+        if (ring.wait(events, kReactorPollMs) < 0)
+        {
+            std::cerr << "io_uring wait failed." << std::endl;
+            break;
+        }
+
+        for (const UringEvent &event : events)
+        {
+            if (event.op == URING_ACCEPT)
+            {
+                if (event.res >= 0)
+                {
+                    std::shared_ptr<Connection> conn = adoptClient(event.res, ring, owned);
+                    if (conn)
+                    {
+                        uint32_t tag = ++nextTag;
+                        UringSlot &slot = slots[tag];
+                        slot.conn = conn;
+                        slotByFd[event.res] = tag;
+                        reconcile(tag, slot);
+                    }
+                }
+                else if (event.res != -ECANCELED && isRunning_)
+                {
+                    std::cerr << "Accept failed: " << strerror(-event.res) << std::endl;
+                }
+                if (!event.more && isRunning_)
+                {
+                    ring.accept(listenSocket);
+                }
+                continue;
+            }
+
+            auto it = slots.find(event.tag);
+            if (it == slots.end())
+            {
+                if (event.buffer >= 0)
+                {
+                    ring.recycle(event.buffer);
+                }
+                continue;
+            }
+            UringSlot &slot = it->second;
+            Connection &conn = *slot.conn;
+            auto isOwned = [&]
+            {
+                auto found = owned.find(conn.fd);
+                return found != owned.end() && found->second == slot.conn;
+            };
+            bool live = isOwned();
+
+            if (event.op == URING_SEND)
+            {
+                slot.sending = false;
+                if (live)
+                {
+                    std::lock_guard<std::mutex> lock(conn.outMutex);
+                    if (!conn.closing && event.res < 0)
+                    {
+                        markClosing(conn);
+                    }
+                    else if (!conn.closing)
+                    {
+                        consumeOutbound(conn, event.res);
+                        if (conn.closeWhenDrained && conn.outbound.empty())
+                        {
+                            markClosing(conn);
+                        }
+                        else
+                        {
+                            updateInterest(conn);
+                        }
+                    }
+                }
+                slot.inflight.clear();
+                if (live)
+                {
+                    reconcile(event.tag, slot);
+                }
+            }
+            else if (event.op == URING_RECV)
+            {
+                bool open = event.res > 0 || event.res == -ENOBUFS || event.res == -ECANCELED;
+                if (event.buffer >= 0)
+                {
+                    if (live && event.res > 0)
+                    {
+                        // 复制到连接的行缓冲区，放不下说明单条消息超长
+                        size_t copied = 0;
+                        size_t received = static_cast<size_t>(event.res);
+                        while (copied < received)
+                        {
+                            char *dest = conn.inbound.writePtr(received - copied);
+                            size_t n = std::min(conn.inbound.writable(), received - copied);
+                            if (n == 0)
+                            {
+                                open = false;
+                                break;
+                            }
+                            memcpy(dest, ring.buffer(event.buffer) + copied, n);
+                            conn.inbound.commit(n);
+                            copied += n;
+                        }
+                        conn.lastActive = std::chrono::steady_clock::now();
+                    }
+                    ring.recycle(event.buffer);
+                }
+                if (!event.more)
+                {
+                    slot.recvArmed = false;
+                    slot.recvCancelling = false;
+                }
+
+                if (live)
+                {
+                    if (!dispatchInbound(conn, open))
+                    {
+                        closeClient(owned, conn.fd);
+                    }
+                    else
+                    {
+                        reconcile(event.tag, slot);
+                    }
+                }
+            }
+
+            if (!isOwned() && !slot.sending && !slot.recvArmed)
+            {
+                auto byFd = slotByFd.find(conn.fd);
+                if (byFd != slotByFd.end() && byFd->second == event.tag)
+                {
+                    slotByFd.erase(byFd);
+                }
+                slots.erase(it);
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (config_.idleTimeoutSec > 0 && now - lastIdleCheck >= std::chrono::seconds(kIdleCheckIntervalSec))
+        {
+            lastIdleCheck = now;
+            closeIdleClients(owned);
+        }
+    }
+
+    while (!owned.empty())
+    {
+        closeClient(owned, owned.begin()->first);
+    }
+}
+
+bool TCPServer::dispatchInbound(Connection &conn, bool open)
+{
+    bool keepAlive = true;
+    if (!conn.inbound.empty() && !onClientData(conn.fd, conn.inbound))
+    {
+        keepAlive = false;
+    }
+
+    bool closing;
+    bool drained;
+    {
+        std::lock_guard<std::mutex> lock(conn.outMutex);
+        if (!keepAlive && !conn.closing && !conn.outbound.empty())
+        {
+            // 处理方要求关闭：先把已排队的响应写完
+            conn.closeWhenDrained = true;
+            conn.readPaused = true;
+            conn.writeArmed = true;
+            conn.loop->modify(conn.fd, EVENT_WRITE);
+        }
+        closing = conn.closing;
+        drained = conn.outbound.empty();
+    }
+    return open && !closing && !conn.inbound.full() && (keepAlive || !drained);
+}
+
+std::shared_ptr<Connection> TCPServer::adoptClient(int clientSocket, Poller &loop,
+                                                   std::unordered_map<int, std::shared_ptr<Connection>> &owned)
+{
+    auto conn = std::make_shared<Connection>(clientSocket, &loop);
+    bool accepted;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        accepted = connections_.size() < config_.maxConnections;
+        if (accepted)
+        {
+            connections_[clientSocket] = conn;
+        }
+    }
+    if (!accepted)
+    {
+        std::cerr << "Too many connections, rejecting client." << std::endl;
+        loop.remove(clientSocket);
+        close(clientSocket);
+        return nullptr;
+    }
+
+    owned[clientSocket] = conn;
+    std::cout << "New client connected." << std::endl;
+    if (!onClientConnected(clientSocket))
+    {
+        closeClient(owned, clientSocket);
+        return nullptr;
+    }
+    return conn;
+}
+
+void TCPServer::acceptClients(int listenSocket, EventLoop &loop,
+                              std::unordered_map<int, std::shared_ptr<Connection>> &owned)
+{
+    while (isRunning_)
+    {
+        sockaddr_in clientAddr{};
+        socklen_t clientLen = sizeof(clientAddr);
+        int clientSocket = accept(listenSocket, (struct sockaddr *)&clientAddr, &clientLen);
+        if (clientSocket < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR && isRunning_)
+            {
+                std::cerr << "Accept failed: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+
+        if (!setNonBlocking(clientSocket) || !loop.add(clientSocket, EVENT_READ))
+        {
+            std::cerr << "Failed to register client socket." << std::endl;
+            close(clientSocket);
+            continue;
+        }
+
+        adoptClient(clientSocket, loop, owned);
+    }
+}
+
+bool TCPServer::readFromClient(int clientSocket, LineBuffer &buffer)
+{
+    size_t total = 0;
+    while (total < kMaxReadPerEvent && !buffer.full())
+    {
+        char *dest = buffer.writePtr();
+        if (buffer.writable() == 0)
+        {
+            break;
+        }
+
+        ssize_t bytesRead = recv(clientSocket, dest, buffer.writable(), 0);
+        if (bytesRead > 0)
+        {
+            buffer.commit(bytesRead);
+            total += bytesRead;
+            continue;
+        }
+        if (bytesRead == 0)
+        {
+            return false;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
+}
+
+void TCPServer::closeClient(std::unordered_map<int, std::shared_ptr<Connection>> &owned, int clientSocket)
+{
+    auto it = owned.find(clientSocket);
+    std::shared_ptr<Connection> conn = it->second;
+    owned.erase(it);
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        connections_.erase(clientSocket);
+    }
+
+    // 其他线程持有的引用在 closing 之后不再触碰该 fd
+    {
+        std::lock_guard<std::mutex> lock(conn->outMutex);
+        conn->closing = true;
+        conn->outbound.clear();
+        conn->outboundBytes = 0;
+    }
+    conn->loop->remove(clientSocket);
+    onClientDisconnected(clientSocket);
+    close(clientSocket);
+}
+
+void TCPServer::closeIdleClients(std::unordered_map<int, std::shared_ptr<Connection>> &owned)
+{
+    auto deadline = std::chrono::steady_clock::now() - std::chrono::seconds(config_.idleTimeoutSec);
+    std::vector<int> idle;
+    for (const auto &entry : owned)
+    {
+        if (entry.second->lastActive < deadline)
+        {
+            idle.push_back(entry.first);
+        }
+    }
+
+    for (int clientSocket : idle)
+    {
+        std::cout << "Client " << clientSocket << " idle for " << config_.idleTimeoutSec << "s, disconnecting." << std::endl;
+        closeClient(owned, clientSocket);
+    }
+}
+
+void TCPServer::handleWritable(Connection &conn)
+{
+    std::lock_guard<std::mutex> lock(conn.outMutex);
+    if (conn.closing)
+    {
+        return;
+    }
+    if (!flushOutbound(conn) || (conn.closeWhenDrained && conn.outbound.empty()))
+    {
+        markClosing(conn);
+        return;
+    }
+    updateInterest(conn);
+}
+
+bool TCPServer::flushOutbound(Connection &conn)
+{
+    while (!conn.outbound.empty())
+    {
+        iovec iov[kMaxIovecs];
+        int count = fillIovecs(conn, iov, kMaxIovecs);
+
+        ssize_t written = writev(conn.fd, iov, count);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        consumeOutbound(conn, written);
+    }
+    return true;
+}
+
+int TCPServer::fillIovecs(Connection &conn, iovec *iov, int maxCount)
+{
+    int count = 0;
+    for (auto it = conn.outbound.begin(); it != conn.outbound.end() && count < maxCount; ++it, ++count)
+    {
+        const std::string &data = (*it)->data();
+        size_t skip = count == 0 ? conn.outboundOffset : 0;
+        iov[count].iov_base = const_cast<char *>(data.data() + skip);
+        iov[count].iov_len = data.size() - skip;
+    }
+    return count;
+}
+
+void TCPServer::consumeOutbound(Connection &conn, size_t written)
+{
+    conn.outboundBytes -= written;
+    while (written > 0)
+    {
+        size_t left = conn.outbound.front()->data().size() - conn.outboundOffset;
+        if (written < left)
+        {
+            conn.outboundOffset += written;
+            break;
+        }
+        written -= left;
+        conn.outbound.front()->markDelivered();
+        conn.outbound.pop_front();
+        conn.outboundOffset = 0;
+    }
+}
+
+void TCPServer::updateInterest(Connection &conn)
+{
+    bool wantWrite = !conn.outbound.empty();
+    bool pauseRead = conn.readPaused;
+    if (conn.closeWhenDrained)
+    {
+        pauseRead = true;
+    }
+    else if (conn.outboundBytes >= config_.sendHighWatermark)
+    {
+        pauseRead = true;
+    }
+    else if (conn.outboundBytes <= config_.sendLowWatermark)
+    {
+        pauseRead = false;
+    }
+
+    if (wantWrite != conn.writeArmed || pauseRead != conn.readPaused)
+    {
+        conn.writeArmed = wantWrite;
+        conn.readPaused = pauseRead;
+        uint32_t flags = 0;
+        if (!pauseRead)
+        {
+            flags |= EVENT_READ;
+        }
+        if (wantWrite)
+        {
+            flags |= EVENT_WRITE;
+        }
+        conn.loop->modify(conn.fd, flags);
+    }
+}
+
+void TCPServer::markClosing(Connection &conn)
+{
+    // 由所属事件循环关闭：停止双向传输并重新监听读事件，使其读到 EOF
+    conn.closing = true;
+    conn.outbound.clear();
+    conn.outboundBytes = 0;
+    shutdown(conn.fd, SHUT_RDWR);
+    conn.loop->modify(conn.fd, EVENT_READ);
+}
+
+void TCPServer::queueMessage(Connection &conn, const SharedBuffer &message)
+{
+    std::lock_guard<std::mutex> lock(conn.outMutex);
+    if (conn.closing)
+    {
+        return;
+    }
+
+    conn.outboundBytes += message->data().size();
+    conn.outbound.push_back(message);
+
+    // 队列为空时直接在调用线程写出，剩余部分交给事件循环；
+    // io_uring 模式下由事件循环统一批量提交
+    if (!conn.writeArmed && !conn.loop->submitsWrites() && !flushOutbound(conn))
+    {
+        markClosing(conn);
+        return;
+    }
+
+    if (conn.outboundBytes > config_.maxSendQueueBytes)
+    {
+        std::cerr << "Client " << conn.fd << " is too slow (" << conn.outboundBytes
+                  << " bytes queued), disconnecting." << std::endl;
+        markClosing(conn);
+        return;
+    }
+    updateInterest(conn);
+}
+
+bool TCPServer::onClientConnected(int)
+{
+    return true;
+}
+
+bool TCPServer::onClientData(int clientSocket, LineBuffer &buffer)
+{
+    return serveHttp(clientSocket, buffer);
+}
+
+bool TCPServer::serveHttp(int clientSocket, LineBuffer &buffer)
+{
+    // 流水线请求按顺序处理，响应按相同顺序进入发送队列；不完整的请求留待下次读取
+    while (!buffer.empty())
+    {
+        HttpRequest request;
+        size_t consumed = takeHttpRequest(buffer.peek(), request);
+        if (consumed == 0)
+        {
+            return true;
+        }
+        if (consumed == std::string::npos)
+        {
+            HttpResponse response;
+            response.setStatus(400);
+            response.setContent("{\"error\":\"Bad Request\"}");
+            response.keepAlive = false;
+            sendMessage(clientSocket, formatHttpResponse(response));
+            return false;
+        }
+        buffer.consume(consumed);
+
+        std::cout << "Method: " << request.method << ", Path: " << request.path << std::endl;
+        handleHttpRequest(clientSocket, request);
+        if (!request.keepAlive)
+        {
+            return false;
+        }
     }
     return true;
 }
 
+size_t TCPServer::takeHttpRequest(std::string_view data, HttpRequest &request)
+{
+    size_t headerEnd = data.find("\r\n\r\n");
+    if (headerEnd == std::string_view::npos)
+    {
+        return 0;
+    }
+
+    std::string head(data.substr(0, headerEnd + 4));
+    std::cout << "Received request:\n"
+              << head << std::endl;
+    request = parseHttpRequest(head);
+    if (request.method.empty() || request.path.empty())
+    {
+        return std::string::npos;
+    }
+
+    size_t pos = headerEnd + 4;
+    if (containsToken(headerValue(request, "Transfer-Encoding"), "chunked"))
+    {
+        // 分块请求体：<十六进制长度>[;扩展]\r\n<数据>\r\n ... 0\r\n[尾部头]\r\n
+        std::string body;
+        while (true)
+        {
+            size_t lineEnd = data.find("\r\n", pos);
+            if (lineEnd == std::string_view::npos)
+            {
+                return 0;
+            }
+            std::string sizeLine(data.substr(pos, lineEnd - pos));
+            char *end = nullptr;
+            unsigned long chunkSize = strtoul(sizeLine.c_str(), &end, 16);
+            if (end == sizeLine.c_str() || (*end != '\0' && *end != ';' && *end != ' '))
+            {
+                return std::string::npos;
+            }
+            pos = lineEnd + 2;
+
+            if (chunkSize == 0)
+            {
+                while (true)
+                {
+                    size_t trailerEnd = data.find("\r\n", pos);
+                    if (trailerEnd == std::string_view::npos)
+                    {
+                        return 0;
+                    }
+                    bool last = trailerEnd == pos;
+                    pos = trailerEnd + 2;
+                    if (last)
+                    {
+                        break;
+                    }
+                }
+                break;
+            }
+
+            if (data.size() < pos + chunkSize + 2)
+            {
+                return 0;
+            }
+            if (data.substr(pos + chunkSize, 2) != "\r\n")
+            {
+                return std::string::npos;
+            }
+            body.append(data.data() + pos, chunkSize);
+            pos += chunkSize + 2;
+        }
+        request.body = std::move(body);
+        return pos;
+    }
+
+    std::string contentLength = headerValue(request, "Content-Length");
+    if (!contentLength.empty())
+    {
+        if (contentLength.find_first_not_of("0123456789") != std::string::npos || contentLength.size() > 9)
+        {
+            return std::string::npos;
+        }
+        size_t length = std::stoul(contentLength);
+        if (data.size() < pos + length)
+        {
+            return 0;
+        }
+        request.body.assign(data.data() + pos, length);
+        pos += length;
+    }
+    return pos;
+}
+
+void TCPServer::onClientDisconnected(int clientSocket)
+{
+    std::cout << "Client " << clientSocket << " disconnected." << std::endl;
+}
+
 void TCPServer::stop()
 {
     isRunning_ = false;
-    if (serverSocket_ >= 0)
+    for (int listenSocket : listenSockets_)
     {
-        close(serverSocket_);
-        serverSocket_ = -1;
+        close(listenSocket);
     }
+    listenSockets_.clear();
 
     for (auto &thread : clientThreads_)
     {
@@ -100,17 +1019,20 @@ void TCPServer::stop()
 
 void TCPServer::handleClient(int clientSocket)
 {
-    std::string message = receiveMessage(clientSocket);
-    if (!message.empty())
+    LineBuffer buffer;
+    while (isRunning_ && !buffer.full())
     {
-        std::cout << "Received request:\n"
-                  << message << std::endl;
-
-        HttpRequest request = parseHttpRequest(message);
-        std::cout << "Method: " << request.method << ", Path: " << request.path << std::endl;
-
-        HttpResponse response;
-        handleHttpRequest(clientSocket, request);
+        char *dest = buffer.writePtr();
+        ssize_t bytesRead = recv(clientSocket, dest, buffer.writable(), 0);
+        if (bytesRead <= 0)
+        {
+            break;
+        }
+        buffer.commit(bytesRead);
+        if (!serveHttp(clientSocket, buffer))
+        {
+            break;
+        }
     }
 
     close(clientSocket);
@@ -127,7 +1049,7 @@ HttpRequest TCPServer::parseHttpRequest(const std::string &message)
     if (std::getline(iss, line))
     {
         std::istringstream lineStream(line);
-        lineStream >> request.method >> request.path;
+        lineStream >> request.method >> request.path >> request.version;
     }
 
     // 解析请求头
@@ -137,11 +1059,26 @@ HttpRequest TCPServer::parseHttpRequest(const std::string &message)
         if (pos != std::string::npos)
         {
             std::string name = line.substr(0, pos);
-            std::string value = line.substr(pos + 2);
+            size_t valueStart = line.find_first_not_of(' ', pos + 1);
+            size_t valueEnd = line.find_last_not_of(" \r");
+            std::string value = valueStart == std::string::npos || valueEnd < valueStart
+                                    ? ""
+                                    : line.substr(valueStart, valueEnd - valueStart + 1);
             request.headers[name] = value;
         }
     }
 
+    // HTTP/1.1 默认长连接，HTTP/1.0 需显式声明 keep-alive
+    std::string connection = headerValue(request, "Connection");
+    if (request.version == "HTTP/1.0")
+    {
+        request.keepAlive = containsToken(connection, "keep-alive");
+    }
+    else
+    {
+        request.keepAlive = !containsToken(connection, "close");
+    }
+
     return request;
 }
 
@@ -159,6 +1096,7 @@ void TCPServer::handleHttpRequest(int clientSocket, const HttpRequest &request)
         response.headers["Access-Control-Max-Age"] = "86400";
         response.headers["Content-Type"] = "text/plain";
         response.setContent("");
+        response.keepAlive = request.keepAlive;
 
         std::string responseStr = formatHttpResponse(response);
         sendMessage(clientSocket, responseStr);
@@ -186,6 +1124,7 @@ void TCPServer::handleHttpRequest(int clientSocket, const HttpRequest &request)
     }
 
     // 发送响应
+    response.keepAlive = request.keepAlive;
     std::string responseStr = formatHttpResponse(response);
     sendMessage(clientSocket, responseStr);
 }
@@ -203,6 +1142,8 @@ std::string TCPServer::formatHttpResponse(const HttpResponse &response)
         oss << "Internal Server Error";
     else if (response.status == 400)
         oss << "Bad Request";
+    else if (response.status == 405)
+        oss << "Method Not Allowed";
 
     oss << "\r\n";
 
@@ -218,7 +1159,20 @@ std::string TCPServer::formatHttpResponse(const HttpResponse &response)
         oss << header.first << ": " << header.second << "\r\n";
     }
 
-    oss << "Connection: keep-alive\r\n"; // 添加 Connection 头
+    // 响应体长度明确，客户端才能在同一连接上区分相邻的响应
+    oss << "Content-Length: " << response.content.size() << "\r\n";
+    if (response.keepAlive)
+    {
+        oss << "Connection: keep-alive\r\n";
+        if (config_.idleTimeoutSec > 0)
+        {
+            oss << "Keep-Alive: timeout=" << config_.idleTimeoutSec << "\r\n";
+        }
+    }
+    else
+    {
+        oss << "Connection: close\r\n";
+    }
     oss << "\r\n"
         << response.content;
 
@@ -227,7 +1181,57 @@ std::string TCPServer::formatHttpResponse(const HttpResponse &response)
 
 void TCPServer::sendMessage(int clientSocket, const std::string &message)
 {
-    send(clientSocket, message.c_str(), message.size(), 0);
+    sendShared(clientSocket, std::make_shared<OutboundBuffer>(message));
+}
+
+std::shared_ptr<Connection> TCPServer::findConnection(int clientSocket)
+{
+    std::lock_guard<std::mutex> lock(connectionsMutex_);
+    auto it = connections_.find(clientSocket);
+    return it == connections_.end() ? nullptr : it->second;
+}
+
+void TCPServer::sendShared(Connection &conn, const SharedBuffer &message)
+{
+    queueMessage(conn, message);
+}
+
+void TCPServer::sendShared(int clientSocket, const SharedBuffer &message)
+{
+    std::shared_ptr<Connection> conn;
+    {
+        std::lock_guard<std::mutex> lock(connectionsMutex_);
+        auto it = connections_.find(clientSocket);
+        if (it != connections_.end())
+        {
+            conn = it->second;
+        }
+    }
+    if (conn)
+    {
+        queueMessage(*conn, message);
+        return;
+    }
+
+    // 每连接一个线程的模式下 socket 为阻塞模式，直接写出
+    const std::string &data = message->data();
+    size_t sent = 0;
+    while (sent < data.size())
+    {
+        ssize_t n = send(clientSocket, data.data() + sent, data.size() - sent, 0);
+        if (n > 0)
+        {
+            sent += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        std::cerr << "Failed to send message to client " << clientSocket << std::endl;
+        return;
+    }
+    message->markDelivered();
 }
 
 std::string TCPServer::receiveMessage(int clientSocket)
@@ -0,0 +1,431 @@
+#include "uring_loop.h"
+#include <iostream>
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <cstring>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#endif
+#endif
+
+#if defined(IORING_RECV_MULTISHOT) && defined(IORING_FEAT_EXT_ARG)
+#define HAVE_IO_URING 1
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#endif
+
+bool UringLoop::modify(int fd, uint32_t)
+{
+    {
+        std::lock_guard<std::mutex> lock(dirtyMutex_);
+        dirty_.push_back(fd);
+    }
+    // The loop drains dirty descriptors before it waits again, so it only needs a wake-up
+    // when the change comes from another thread
+    if (loopThread_.load(std::memory_order_relaxed) != std::this_thread::get_id() &&
+        !wakePending_.exchange(true))
+    {
+        uint64_t one = 1;
+        if (write(wakeFd_, &one, sizeof(one)) < 0 && errno != EAGAIN)
+        {
+            std::cerr << "Failed to wake io_uring loop: " << strerror(errno) << std::endl;
+        }
+    }
+    return true;
+}
+
+void UringLoop::remove(int fd)
+{
+    shutdown(fd, SHUT_RDWR);
+}
+
+void UringLoop::takeDirty(std::vector<int> &fds)
+{
+    fds.clear();
+    std::lock_guard<std::mutex> lock(dirtyMutex_);
+    fds.swap(dirty_);
+}
+
+#ifdef HAVE_IO_URING
+
+namespace
+{
+const uint16_t kBufferGroup = 0;
+
+uint64_t packUserData(UringOp op, uint32_t tag)
+{
+    return (static_cast<uint64_t>(op) << 56) | tag;
+}
+
+int sysSetup(unsigned entries, io_uring_params *params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+int sysEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags, const void *arg, size_t argSize)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, arg, argSize));
+}
+
+}
+
+struct UringLoop::Ring
+{
+    int fd = -1;
+
+    void *ringMap = nullptr;
+    size_t ringMapSize = 0;
+    io_uring_sqe *sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned *sqHead = nullptr;
+    unsigned *sqTail = nullptr;
+    unsigned *sqArray = nullptr;
+    unsigned sqMask = 0;
+    unsigned sqEntries = 0;
+    unsigned localTail = 0; // next free SQE; published to the kernel by submit()
+
+    unsigned *cqHead = nullptr;
+    unsigned *cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe *cqes = nullptr;
+};
+
+bool UringLoop::supported()
+{
+    // Multishot receive arrived in 6.0
+    utsname name;
+    int major = 0;
+    int minor = 0;
+    if (uname(&name) != 0 || sscanf(name.release, "%d.%d", &major, &minor) != 2 || major < 6)
+    {
+        return false;
+    }
+
+    UringLoop probe(8, 8, 64);
+    return probe.valid();
+}
+
+UringLoop::UringLoop(unsigned entries, unsigned bufferCount, unsigned bufferSize)
+    : ring_(new Ring), bufferSize_(bufferSize)
+{
+    Ring &r = *ring_;
+    io_uring_params params{};
+    params.flags = IORING_SETUP_CLAMP;
+    r.fd = sysSetup(entries, &params);
+    if (r.fd < 0)
+    {
+        std::cerr << "io_uring_setup failed: " << strerror(errno) << std::endl;
+        return;
+    }
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG) ||
+        !(params.features & IORING_FEAT_NODROP))
+    {
+        std::cerr << "io_uring lacks required features." << std::endl;
+        return;
+    }
+
+    size_t sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    r.ringMapSize = std::max(sqSize, cqSize);
+    r.ringMap = mmap(nullptr, r.ringMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_SQ_RING);
+    r.sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    r.sqes = static_cast<io_uring_sqe *>(
+        mmap(nullptr, r.sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, r.fd, IORING_OFF_SQES));
+    if (r.ringMap == MAP_FAILED || r.sqes == MAP_FAILED)
+    {
+        std::cerr << "Failed to map io_uring rings: " << strerror(errno) << std::endl;
+        r.ringMap = r.ringMap == MAP_FAILED ? nullptr : r.ringMap;
+        r.sqes = r.sqes == MAP_FAILED ? nullptr : r.sqes;
+        return;
+    }
+
+    char *base = static_cast<char *>(r.ringMap);
+    r.sqHead = reinterpret_cast<unsigned *>(base + params.sq_off.head);
+    r.sqTail = reinterpret_cast<unsigned *>(base + params.sq_off.tail);
+    r.sqArray = reinterpret_cast<unsigned *>(base + params.sq_off.array);
+    r.sqMask = *reinterpret_cast<unsigned *>(base + params.sq_off.ring_mask);
+    r.sqEntries = params.sq_entries;
+    r.localTail = *r.sqTail;
+    r.cqHead = reinterpret_cast<unsigned *>(base + params.cq_off.head);
+    r.cqTail = reinterpret_cast<unsigned *>(base + params.cq_off.tail);
+    r.cqMask = *reinterpret_cast<unsigned *>(base + params.cq_off.ring_mask);
+    r.cqes = reinterpret_cast<io_uring_cqe *>(base + params.cq_off.cqes);
+
+    // Hand the whole receive pool to the kernel; it picks a buffer per completion.
+    // Classic provided buffers rather than a registered buffer ring: the latter is not
+    // usable on every kernel that has multishot receive
+    bufferCount_ = std::min(bufferCount, 65535u);
+    buffers_.reset(new char[static_cast<size_t>(bufferCount_) * bufferSize_]);
+    provideBuffers(0, bufferCount_);
+
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ < 0)
+    {
+        std::cerr << "eventfd failed: " << strerror(errno) << std::endl;
+        return;
+    }
+    armWake();
+    ready_ = true;
+}
+
+UringLoop::~UringLoop()
+{
+    Ring &r = *ring_;
+    // Closing the ring cancels whatever is still in flight
+    if (r.fd >= 0)
+    {
+        close(r.fd);
+    }
+    if (r.sqes)
+    {
+        munmap(r.sqes, r.sqesSize);
+    }
+    if (r.ringMap)
+    {
+        munmap(r.ringMap, r.ringMapSize);
+    }
+    if (wakeFd_ >= 0)
+    {
+        close(wakeFd_);
+    }
+}
+
+void *UringLoop::nextSqe()
+{
+    Ring &r = *ring_;
+    unsigned head = __atomic_load_n(r.sqHead, __ATOMIC_ACQUIRE);
+    if (r.localTail - head >= r.sqEntries)
+    {
+        // Submission queue full: hand what we have to the kernel to make room
+        submit(0, 0);
+        head = __atomic_load_n(r.sqHead, __ATOMIC_ACQUIRE);
+        if (r.localTail - head >= r.sqEntries)
+        {
+            std::cerr << "io_uring submission queue full." << std::endl;
+            return nullptr;
+        }
+    }
+
+    unsigned index = r.localTail & r.sqMask;
+    io_uring_sqe *sqe = &r.sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r.sqArray[index] = index;
+    ++r.localTail;
+    return sqe;
+}
+
+bool UringLoop::submit(unsigned minComplete, int timeoutMs)
+{
+    Ring &r = *ring_;
+    __atomic_store_n(r.sqTail, r.localTail, __ATOMIC_RELEASE);
+    unsigned toSubmit = r.localTail - __atomic_load_n(r.sqHead, __ATOMIC_ACQUIRE);
+
+    int ret;
+    if (minComplete > 0)
+    {
+        __kernel_timespec ts{};
+        ts.tv_sec = timeoutMs / 1000;
+        ts.tv_nsec = (timeoutMs % 1000) * 1000000L;
+        io_uring_getevents_arg arg{};
+        arg.ts = reinterpret_cast<uint64_t>(&ts);
+        ret = sysEnter(r.fd, toSubmit, minComplete, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    }
+    else if (toSubmit > 0)
+    {
+        ret = sysEnter(r.fd, toSubmit, 0, 0, nullptr, 0);
+    }
+    else
+    {
+        return true;
+    }
+
+    if (ret < 0 && errno != ETIME && errno != EINTR && errno != EBUSY && errno != EAGAIN)
+    {
+        std::cerr << "io_uring_enter failed: " << strerror(errno) << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void UringLoop::accept(int listenFd)
+{
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listenFd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = packUserData(URING_ACCEPT, 0);
+}
+
+void UringLoop::recv(int fd, uint32_t tag)
+{
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = packUserData(URING_RECV, tag);
+}
+
+void UringLoop::send(int fd, uint32_t tag, const iovec *iov, int count)
+{
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_WRITEV;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(iov);
+    sqe->len = static_cast<uint32_t>(count);
+    sqe->user_data = packUserData(URING_SEND, tag);
+}
+
+void UringLoop::cancelRecv(uint32_t tag)
+{
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = packUserData(URING_RECV, tag);
+    sqe->user_data = packUserData(URING_CANCEL, tag);
+}
+
+void UringLoop::armWake()
+{
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = wakeFd_;
+    sqe->addr = reinterpret_cast<uint64_t>(&wakeValue_);
+    sqe->len = sizeof(wakeValue_);
+    sqe->user_data = packUserData(URING_WAKE, 0);
+}
+
+void UringLoop::provideBuffers(int first, unsigned count)
+{
+    io_uring_sqe *sqe = static_cast<io_uring_sqe *>(nextSqe());
+    if (!sqe)
+    {
+        return;
+    }
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = static_cast<int>(count);
+    sqe->addr = reinterpret_cast<uint64_t>(buffer(first));
+    sqe->len = bufferSize_;
+    sqe->off = static_cast<uint64_t>(first);
+    sqe->buf_group = kBufferGroup;
+    sqe->user_data = packUserData(URING_BUFFERS, 0);
+}
+
+void UringLoop::recycle(int id)
+{
+    // Goes out with the next submission, ahead of any receive queued after it
+    provideBuffers(id, 1);
+}
+
+int UringLoop::wait(std::vector<UringEvent> &events, int timeoutMs)
+{
+    Ring &r = *ring_;
+    events.clear();
+    loopThread_.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+    bool ready = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE) != *r.cqHead;
+    if (!submit(ready ? 0 : 1, timeoutMs))
+    {
+        return -1;
+    }
+
+    unsigned head = *r.cqHead;
+    unsigned tail = __atomic_load_n(r.cqTail, __ATOMIC_ACQUIRE);
+    bool rearmWake = false;
+    for (; head != tail; ++head)
+    {
+        const io_uring_cqe &cqe = r.cqes[head & r.cqMask];
+        UringEvent event;
+        event.op = static_cast<UringOp>(cqe.user_data >> 56);
+        event.tag = static_cast<uint32_t>(cqe.user_data);
+        event.res = cqe.res;
+        event.more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+        event.buffer = (cqe.flags & IORING_CQE_F_BUFFER) ? static_cast<int>(cqe.flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+
+        if (event.op == URING_WAKE)
+        {
+            rearmWake = true;
+            continue;
+        }
+        if (event.op == URING_BUFFERS && event.res < 0)
+        {
+            std::cerr << "Failed to provide io_uring buffers: " << strerror(-event.res) << std::endl;
+        }
+        if (event.op == URING_CANCEL || event.op == URING_BUFFERS)
+        {
+            continue;
+        }
+        events.push_back(event);
+    }
+    __atomic_store_n(r.cqHead, head, __ATOMIC_RELEASE);
+
+    if (rearmWake)
+    {
+        wakePending_.store(false);
+        armWake();
+    }
+    return static_cast<int>(events.size());
+}
+
+#else // !HAVE_IO_URING
+
+struct UringLoop::Ring
+{
+};
+
+bool UringLoop::supported()
+{
+    return false;
+}
+
+UringLoop::UringLoop(unsigned, unsigned, unsigned bufferSize) : ring_(new Ring), bufferSize_(bufferSize) {}
+
+UringLoop::~UringLoop() {}
+
+void *UringLoop::nextSqe() { return nullptr; }
+bool UringLoop::submit(unsigned, int) { return false; }
+void UringLoop::accept(int) {}
+void UringLoop::recv(int, uint32_t) {}
+void UringLoop::send(int, uint32_t, const iovec *, int) {}
+void UringLoop::cancelRecv(uint32_t) {}
+void UringLoop::armWake() {}
+void UringLoop::provideBuffers(int, unsigned) {}
+void UringLoop::recycle(int) {}
+
+int UringLoop::wait(std::vector<UringEvent> &events, int)
+{
+    events.clear();
+    return -1;
+}
+
+#endif
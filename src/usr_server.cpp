@@ -32,8 +32,12 @@ int main()
         std::cout << "│   └── POST /api/miner/submit" << std::endl;
         std::cout << "└── 等待请求..." << std::endl;
 
+        // 仪表盘轮询复用长连接，空闲超过该时间的连接由服务端关闭
+        ServerConfig config;
+        config.idleTimeoutSec = 15;
+
         // 初始化 TCP 服务器
-        TCPServer server(httpPort);
+        TCPServer server(httpPort, config);
         g_server = &server;
 
         // 启动服务
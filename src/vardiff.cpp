@@ -0,0 +1,94 @@
+#include "vardiff.h"
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+// Largest factor a single retarget may change the difficulty by
+const double kMaxRetargetStep = 4.0;
+// How long the previous, easier target is still honoured after a retarget
+const std::chrono::seconds kRetargetGrace(5);
+}
+
+void VardiffController::reset(const VardiffConfig &config, Clock::time_point now)
+{
+    config_ = &config;
+    windowStart_ = now;
+    windowShares_ = 0;
+    difficulty_ = std::clamp(config.initialDifficulty, config.minDifficulty, config.maxDifficulty);
+    target_ = kDiff1Target.divideByDifficulty(difficulty_);
+    graceTarget_ = target_;
+    graceUntil_ = now;
+}
+
+const Uint256 &VardiffController::shareTarget(Clock::time_point now) const
+{
+    return now < graceUntil_ ? graceTarget_ : target_;
+}
+
+bool VardiffController::recordShare(Clock::time_point now)
+{
+    ++windowShares_;
+    double elapsed = std::chrono::duration<double>(now - windowStart_).count();
+    double expected = config_->retargetSeconds / config_->targetShareSeconds;
+    if (elapsed < config_->retargetSeconds && windowShares_ < 2 * expected)
+    {
+        return false;
+    }
+    return retarget(elapsed, now);
+}
+
+bool VardiffController::retargetIdle(Clock::time_point now)
+{
+    double elapsed = std::chrono::duration<double>(now - windowStart_).count();
+    if (elapsed < config_->retargetSeconds)
+    {
+        return false;
+    }
+    return retarget(elapsed, now);
+}
+
+bool VardiffController::retarget(double elapsed, Clock::time_point now)
+{
+    // ratio > 1: shares come faster than wanted, so the difficulty goes up
+    double ratio = config_->targetShareSeconds * windowShares_ / std::max(elapsed, 1e-3);
+    windowStart_ = now;
+    windowShares_ = 0;
+    if (ratio > 1 - config_->variance && ratio < 1 + config_->variance)
+    {
+        return false;
+    }
+    ratio = std::clamp(ratio, 1 / kMaxRetargetStep, kMaxRetargetStep);
+    return setDifficulty(difficulty_ * ratio, now);
+}
+
+bool VardiffController::suggest(double difficulty, Clock::time_point now)
+{
+    windowStart_ = now;
+    windowShares_ = 0;
+    return setDifficulty(difficulty, now);
+}
+
+bool VardiffController::setDifficulty(double difficulty, Clock::time_point now)
+{
+    difficulty = std::clamp(difficulty, config_->minDifficulty, config_->maxDifficulty);
+    if (difficulty == difficulty_)
+    {
+        return false;
+    }
+
+    Uint256 target = kDiff1Target.divideByDifficulty(difficulty);
+    graceTarget_ = std::max(target, target_);
+    graceUntil_ = now + kRetargetGrace;
+    target_ = target;
+    difficulty_ = difficulty;
+    return true;
+}
+
+std::string buildSetDifficultyMessage(double difficulty)
+{
+    // 17 significant digits round-trip the double, so the miner derives the same target
+    char message[96];
+    snprintf(message, sizeof(message), "{\"id\":null,\"method\":\"mining.set_difficulty\",\"params\":[%.17g]}\n", difficulty);
+    return message;
+}